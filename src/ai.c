@@ -0,0 +1,462 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "draw.h"
+#include "interact.h"
+#include "hint.h"
+#include "route.h"
+#include "event.h"
+#include "ai.h"
+
+#define AI_MAX_THREADS 16
+#define AI_MAX_NODES 65536 /* Per tree. Once it's full the search goes on with playouts alone. */
+#define AI_MAX_DEPTH 256
+#define AI_MAX_PIECES 16
+#define AI_MAX_MOVES (AI_MAX_PIECES * 4)
+#define AI_PLAYOUT_DEPTH 60
+#define AI_EXPLORATION 1.4f
+
+/*
+ Monte Carlo tree search with root parallelization. Every thread grows its own tree from the same
+ position with its own random playouts, and the trees are only combined at the end by adding up how
+ often each of the dragon's moves was tried. No locks are needed while searching.
+
+ Positions aren't stored in the tree. Each iteration copies the root position and replays the moves
+ down to the node it expands, through components_command_move() like any other move, so the dragon
+ is held to munch_allowed() and only moves once every other piece has had its turn. A dragon with no
+ legal move passes, which ends the round. A player with no legal move can't win.
+
+ Rewards are from the dragon's point of view: 1 for eating, 0 for getting slain and 0.5 for a
+ playout that runs out of moves first.
+ */
+
+static const Coord dir_dx[] = {0, 1, 0, -1};
+static const Coord dir_dy[] = {-1, 0, 1, 0};
+
+typedef struct {
+    Move move; /* Leads here from the parent. A subject of 0 passes. */
+    uint32_t first_child;
+    uint32_t visits;
+    float_t score; /* Total reward for the side that made the move. */
+    float_t reward; /* Reward of a terminal node. */
+    uint8_t nchildren;
+    bool expanded;
+    bool terminal;
+    bool dragon; /* The dragon made the move. */
+} AiNode;
+
+typedef struct {
+    Components* root;
+    uint32_t deadline;
+    SDL_atomic_t* cancel;
+    uint64_t random;
+    Components scratch;
+    AiNode* nodes;
+    uint32_t nnodes;
+    uint32_t iterations;
+} AiTree;
+
+/* splitmix64, so each tree gets its own random stream. */
+static uint64_t random_next(uint64_t* state) {
+    *state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = *state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint32_t random_below(uint64_t* state, uint32_t bound) {
+    return (uint32_t)(random_next(state) % bound);
+}
+
+/*
+ Lists the pieces that aren't on cooldown for the side whose turn it is.
+ dragon: Set to true if it's the dragon's turn.
+ Returns: The number of pieces.
+ */
+static uint8_t ai_movers(Components* comps, Entity* movers, bool* dragon) {
+    Entity dragons[AI_MAX_PIECES];
+    uint8_t ndragons = 0;
+    uint8_t nmovers = 0;
+
+    CompGroup* groups[] = {&comps->compgroups[COMPTYPE_SELECTABLE]};
+    void* iter[] = {NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 1)) {
+        Entity entity = ((CSelectable*)iter[0])->entity;
+        if (cooldown_active(comps, entity)) {
+            continue;
+        }
+        if (component_of(&comps->compgroups[COMPTYPE_SLAYME], entity) != NULL) {
+            if (ndragons < AI_MAX_PIECES) {
+                dragons[ndragons] = entity;
+                ndragons += 1;
+            }
+        } else if (nmovers < AI_MAX_PIECES) {
+            movers[nmovers] = entity;
+            nmovers += 1;
+        }
+    }
+
+    *dragon = nmovers == 0;
+    if (*dragon) {
+        memcpy(movers, dragons, ndragons * sizeof(Entity));
+        nmovers = ndragons;
+    }
+    return nmovers;
+}
+
+/*
+ dragon: Set to true if it's the dragon's turn.
+ Returns: The number of legal moves for the side whose turn it is.
+ */
+static uint8_t ai_moves(Components* comps, Move* moves, bool* dragon) {
+    Entity movers[AI_MAX_PIECES];
+    uint8_t nmovers = ai_movers(comps, movers, dragon);
+
+    uint8_t nmoves = 0;
+    for (uint8_t r = 0; r < nmovers; r += 1) {
+        CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], movers[r]);
+        if (position == NULL) {
+            continue;
+        }
+        for (uint8_t dir = 0; dir < 4; dir += 1) {
+            Coord x = position->x + dir_dx[dir];
+            Coord y = position->y + dir_dy[dir];
+            if (components_will_move(comps, movers[r], x, y)) {
+                moves[nmoves] = (Move){movers[r], x, y};
+                nmoves += 1;
+            }
+        }
+    }
+    return nmoves;
+}
+
+static Outcome ai_apply(Components* comps, const Move* move) {
+    if (move->subject == 0) {
+        cooldown_reset(comps);
+        return OutcomeMoved;
+    }
+    return components_command_move(comps, move->subject, move->x, move->y);
+}
+
+static float_t ai_playout(AiTree* tree, Components* comps) {
+    Move moves[AI_MAX_MOVES];
+    bool dragon;
+    for (uint16_t r = 0; r < AI_PLAYOUT_DEPTH; r += 1) {
+        uint8_t nmoves = ai_moves(comps, moves, &dragon);
+        if (nmoves == 0) {
+            if (!dragon) {
+                return 1;
+            }
+            cooldown_reset(comps);
+            continue;
+        }
+
+        Move* move = &moves[random_below(&tree->random, nmoves)];
+        Outcome outcome = components_command_move(comps, move->subject, move->x, move->y);
+        if (outcome == OutcomeLost) {
+            return 1;
+        } else if (outcome == OutcomeWon) {
+            return 0;
+        }
+    }
+    return 0.5f;
+}
+
+/*
+ Adds a child for each legal move in comps, which is the position at the node.
+ Returns: false if there's no room for the children.
+ */
+static bool ai_expand(AiTree* tree, uint32_t index, Components* comps) {
+    Move moves[AI_MAX_MOVES];
+    bool dragon;
+    uint8_t nmoves = ai_moves(comps, moves, &dragon);
+    AiNode* node = &tree->nodes[index];
+    if (nmoves == 0) {
+        if (!dragon) {
+            node->terminal = true;
+            node->reward = 1;
+            return true;
+        }
+        moves[0] = (Move){0, 0, 0};
+        nmoves = 1;
+    }
+    if (tree->nnodes + nmoves > AI_MAX_NODES) {
+        return false;
+    }
+
+    node->first_child = tree->nnodes;
+    node->nchildren = nmoves;
+    node->expanded = true;
+    for (uint8_t r = 0; r < nmoves; r += 1) {
+        AiNode* child = &tree->nodes[tree->nnodes];
+        memset(child, 0, sizeof(AiNode));
+        child->move = moves[r];
+        child->dragon = dragon;
+        tree->nnodes += 1;
+    }
+    return true;
+}
+
+/*
+ Returns: The child to descend into, which is the first unvisited one if there is any.
+ */
+static uint32_t ai_select(AiTree* tree, AiNode* node) {
+    float_t log_visits = logf((float_t)node->visits);
+    uint32_t best = node->first_child;
+    float_t best_value = -1;
+    for (uint8_t r = 0; r < node->nchildren; r += 1) {
+        AiNode* child = &tree->nodes[node->first_child + r];
+        if (child->visits == 0) {
+            return node->first_child + r;
+        }
+        float_t value = child->score / child->visits
+            + AI_EXPLORATION * sqrtf(log_visits / child->visits);
+        if (value > best_value) {
+            best_value = value;
+            best = node->first_child + r;
+        }
+    }
+    return best;
+}
+
+static void ai_iterate(AiTree* tree) {
+    Components* comps = &tree->scratch;
+    if (components_copy(comps, tree->root) != 0) {
+        ERROR("components_copy");
+        return;
+    }
+
+    uint32_t path[AI_MAX_DEPTH];
+    uint16_t depth = 0;
+    uint32_t index = 0;
+    float_t reward;
+    while (true) {
+        path[depth] = index;
+        depth += 1;
+
+        AiNode* node = &tree->nodes[index];
+        if (!node->expanded && !node->terminal && !ai_expand(tree, index, comps)) {
+            reward = ai_playout(tree, comps);
+            break;
+        }
+        if (node->terminal) {
+            reward = node->reward;
+            break;
+        }
+        if (depth >= AI_MAX_DEPTH) {
+            reward = ai_playout(tree, comps);
+            break;
+        }
+
+        index = ai_select(tree, node);
+        AiNode* child = &tree->nodes[index];
+        Outcome outcome = ai_apply(comps, &child->move);
+        if (outcome == OutcomeLost || outcome == OutcomeWon) {
+            child->terminal = true;
+            child->reward = outcome == OutcomeLost ? 1 : 0;
+        }
+        if (child->visits == 0 && !child->terminal) {
+            path[depth] = index;
+            depth += 1;
+            reward = ai_playout(tree, comps);
+            break;
+        }
+    }
+
+    for (uint16_t r = 0; r < depth; r += 1) {
+        AiNode* node = &tree->nodes[path[r]];
+        node->visits += 1;
+        node->score += node->dragon ? reward : 1 - reward;
+    }
+    tree->iterations += 1;
+}
+
+static int ai_search(void* data) {
+    AiTree* tree = (AiTree*)data;
+    do {
+        ai_iterate(tree);
+    } while (SDL_GetTicks() < tree->deadline
+        && (tree->cancel == NULL || SDL_AtomicGet(tree->cancel) == 0));
+    return 0;
+}
+
+bool ai_think(Components* comps, uint32_t budget, SDL_atomic_t* cancel, Move* move) {
+    int32_t nthreads = SDL_GetCPUCount();
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > AI_MAX_THREADS) {
+        nthreads = AI_MAX_THREADS;
+    }
+
+    uint32_t start = SDL_GetTicks();
+    uint64_t seed = SDL_GetPerformanceCounter();
+    AiTree trees[AI_MAX_THREADS];
+    int32_t ntrees = 0;
+    for (int32_t r = 0; r < nthreads; r += 1) {
+        AiTree* tree = &trees[ntrees];
+        memset(tree, 0, sizeof(AiTree));
+        tree->nodes = malloc(AI_MAX_NODES * sizeof(AiNode));
+        if (tree->nodes == NULL) {
+            WARN("Out of memory.");
+            break;
+        }
+        memset(&tree->nodes[0], 0, sizeof(AiNode));
+        tree->nnodes = 1;
+        tree->root = comps;
+        tree->deadline = start + budget;
+        tree->cancel = cancel;
+        tree->random = seed ^ ((uint64_t)r * 0xD6E8FEB86659FD93ull);
+        tree->scratch = components_new();
+        ntrees += 1;
+    }
+
+    /* This thread grows the first tree while the others grow the rest. */
+    SDL_Thread* threads[AI_MAX_THREADS];
+    for (int32_t r = 1; r < ntrees; r += 1) {
+        threads[r] = SDL_CreateThread(ai_search, "ai", &trees[r]);
+        if (threads[r] == NULL) {
+            WARN("SDL_CreateThread");
+        }
+    }
+    if (ntrees > 0) {
+        ai_search(&trees[0]);
+    }
+    for (int32_t r = 1; r < ntrees; r += 1) {
+        if (threads[r] != NULL) {
+            SDL_WaitThread(threads[r], NULL);
+        }
+    }
+
+    /* Moves are generated in the same order in every tree, so children line up by index. */
+    bool found = false;
+    uint64_t best_visits = 0;
+    uint32_t iterations = 0;
+    AiNode* root = ntrees > 0 ? &trees[0].nodes[0] : NULL;
+    for (uint8_t c = 0; root != NULL && c < root->nchildren; c += 1) {
+        uint64_t visits = 0;
+        for (int32_t r = 0; r < ntrees; r += 1) {
+            AiNode* other = &trees[r].nodes[0];
+            if (other->nchildren == root->nchildren) {
+                visits += trees[r].nodes[other->first_child + c].visits;
+            }
+        }
+        AiNode* child = &trees[0].nodes[root->first_child + c];
+        if (child->move.subject != 0 && (!found || visits > best_visits)) {
+            found = true;
+            best_visits = visits;
+            *move = child->move;
+        }
+    }
+
+    for (int32_t r = 0; r < ntrees; r += 1) {
+        iterations += trees[r].iterations;
+        components_free(&trees[r].scratch);
+        free(trees[r].nodes);
+    }
+    INFO("Dragon searched %u playouts with %d threads in %ums.",
+        iterations, ntrees, SDL_GetTicks() - start);
+    return found;
+}
+
+int ai_init(State* state) {
+    Ai* ai = &state->ai;
+    ai->budget = AI_DEFAULT_BUDGET_MS;
+    ai->snapshot = components_new();
+    SDL_AtomicSet(&ai->cancel, 0);
+    SDL_AtomicSet(&ai->done, 0);
+    return 0;
+}
+
+void ai_end(State* state) {
+    Ai* ai = &state->ai;
+    if (ai->thread != NULL) {
+        SDL_AtomicSet(&ai->cancel, 1);
+        SDL_WaitThread(ai->thread, NULL);
+        ai->thread = NULL;
+    }
+    components_free(&ai->snapshot);
+}
+
+void ai_toggle(State* state) {
+    state->ai.enabled = !state->ai.enabled;
+    INFO("AI dragon %s.", state->ai.enabled ? "on" : "off");
+    if (!state->ai.enabled) {
+        ai_cancel(state);
+    }
+    hint_cancel(state);
+}
+
+bool ai_controls(State* state, Entity entity) {
+    return state->ai.enabled
+        && component_of(&state->components.compgroups[COMPTYPE_SLAYME], entity) != NULL;
+}
+
+bool ai_turn(Components* comps) {
+    Entity movers[AI_MAX_PIECES];
+    bool dragon;
+    ai_movers(comps, movers, &dragon);
+    return dragon && comps->compgroups[COMPTYPE_SLAYME].alive > 0;
+}
+
+void ai_cancel(State* state) {
+    if (state->ai.thread != NULL) {
+        SDL_AtomicSet(&state->ai.cancel, 1);
+    }
+}
+
+static int ai_worker(void* data) {
+    Ai* ai = (Ai*)data;
+    ai->found = ai_think(&ai->snapshot, ai->budget, &ai->cancel, &ai->found_move);
+    SDL_AtomicSet(&ai->done, 1);
+    events_wake();
+    return 0;
+}
+
+static void ai_start(State* state) {
+    Ai* ai = &state->ai;
+    if (components_copy(&ai->snapshot, &state->components) != 0) {
+        ERROR("components_copy");
+        return;
+    }
+
+    ai->found = false;
+    SDL_AtomicSet(&ai->cancel, 0);
+    SDL_AtomicSet(&ai->done, 0);
+
+    ai->thread = SDL_CreateThread(ai_worker, "ai", ai);
+    if (ai->thread == NULL) {
+        ERROR("SDL_CreateThread");
+        ai->enabled = false;
+    }
+}
+
+void ai_poll(State* state) {
+    Ai* ai = &state->ai;
+    if (ai->thread != NULL) {
+        if (SDL_AtomicGet(&ai->done) == 0) {
+            return;
+        }
+
+        /* The worker has already returned, or is about to, so this doesn't block. */
+        SDL_WaitThread(ai->thread, NULL);
+        ai->thread = NULL;
+
+        if (SDL_AtomicGet(&ai->cancel) == 0 && !state->game_over && ai_turn(&state->components)) {
+            if (ai->found) {
+                command_move(state, ai->found_move.subject, ai->found_move.x, ai->found_move.y);
+            } else {
+                cooldown_reset(&state->components);
+            }
+            hint_cancel(state);
+            route_refresh(state);
+            redraw(state);
+        }
+    }
+
+    if (ai->thread == NULL && ai->enabled && !state->game_over && ai_turn(&state->components)) {
+        ai_start(state);
+    }
+}
@@ -0,0 +1,45 @@
+
+#define AI_DEFAULT_BUDGET_MS 1000
+
+int ai_init(State* state);
+
+/*
+ Cancels any search in progress and waits for it to stop.
+ */
+void ai_end(State* state);
+
+/*
+ Turns the AI opponent on or off. The player can't select the dragon while it's on.
+ */
+void ai_toggle(State* state);
+
+/*
+ Returns: true if the entity is moved by the AI instead of the player.
+ */
+bool ai_controls(State* state, Entity entity);
+
+/*
+ The dragon moves once every other piece has moved this round.
+ Returns: true if it's the dragon's turn to move.
+ */
+bool ai_turn(Components* comps);
+
+/*
+ Stops any search in progress without waiting for it. Call whenever the board changes other than
+ by a move of the AI.
+ */
+void ai_cancel(State* state);
+
+/*
+ Plays the result of a finished search and starts searching when it's the dragon's turn. Never
+ blocks on a search that's still running.
+ */
+void ai_poll(State* state);
+
+/*
+ Searches for the dragon's best move in comps until budget milliseconds have passed or cancel is
+ set, using a search tree on each core.
+ cancel: May be NULL.
+ Returns: false if the dragon has no legal move and has to pass.
+ */
+bool ai_think(Components* comps, uint32_t budget, SDL_atomic_t* cancel, Move* move);
@@ -0,0 +1,436 @@
+/* For mmap(). */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "icon.h"
+#include "draw.h"
+#include "batch.h"
+#include "terrain.h"
+#include "text.h"
+#include "atlas.h"
+#include "assets.h"
+
+/*
+ An assets file is an AssetsHeader followed by the pixels of each page in order, RGBA32 with no
+ padding between rows. The first page is TEXTURE_ATLAS with the sprites at their placements and
+ the rest are the captions. source_hash is of the PNGs that it was baked from, so a file left
+ over from other art gets ignored instead of drawn.
+
+ Files are written in the byte order of the machine that built them.
+ */
+
+#define ASSETS_MAGIC "DEMSAST"
+#define ASSETS_VERSION 1
+#define ASSETS_MAX_PAGES (1 + ATLAS_MAX_IMAGES)
+#define ASSETS_MAX_SIZE 8192 /* Of either side of a page. */
+
+typedef struct {
+    int32_t texture_id;
+    int32_t x; /* Only used for placements. */
+    int32_t y;
+    int32_t w;
+    int32_t h;
+} AssetsRect;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t source_hash;
+    uint64_t file_size;
+    uint32_t npages;
+    uint32_t nplaced;
+    AssetsRect pages[ASSETS_MAX_PAGES];
+    AssetsRect placed[ATLAS_MAX_IMAGES]; /* Where each sprite is in the first page. */
+} AssetsHeader;
+
+static uint64_t hash_bytes(uint64_t hash, const void* mem, size_t size) {
+    /* FNV-1a */
+    const uint8_t* bytes = (const uint8_t*)mem;
+    for (size_t r = 0; r < size; r += 1) {
+        hash ^= bytes[r];
+        hash *= 0x100000001B3u;
+    }
+    return hash;
+}
+
+static uint64_t hash_images(uint64_t hash, const AtlasImage* images, uint8_t count) {
+    for (uint8_t r = 0; r < count; r += 1) {
+        int32_t texture_id = images[r].texture_id;
+        uint64_t size = images[r].size;
+        hash = hash_bytes(hash, &texture_id, sizeof(texture_id));
+        hash = hash_bytes(hash, &size, sizeof(size));
+        hash = hash_bytes(hash, images[r].mem, images[r].size);
+    }
+    return hash;
+}
+
+static uint64_t source_hash(const AssetsSource* source) {
+    uint64_t hash = hash_images(0xCBF29CE484222325u, source->sprites, source->nsprites);
+    return hash_images(hash, source->captions, source->ncaptions);
+}
+
+static bool write_page(FILE* file, SDL_Surface* surface) {
+    for (int32_t y = 0; y < surface->h; y += 1) {
+        const uint8_t* row = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        if (fwrite(row, 4, (size_t)surface->w, file) != (size_t)surface->w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ Returns: 0 if the header and pages could be written to path
+ */
+static int assets_write(
+        const char* path, AssetsHeader* header, SDL_Surface** pages, uint32_t npages) {
+    header->file_size = sizeof(AssetsHeader);
+    for (uint32_t r = 0; r < npages; r += 1) {
+        header->file_size += (uint64_t)pages[r]->w * pages[r]->h * 4;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Couldn't create %s.", path);
+        return 1;
+    }
+    bool written = fwrite(header, sizeof(AssetsHeader), 1, file) == 1;
+    for (uint32_t r = 0; written && r < npages; r += 1) {
+        written = write_page(file, pages[r]);
+    }
+    if (fclose(file) != 0 || !written) {
+        ERROR("Couldn't write %s.", path);
+        return 1;
+    }
+    return 0;
+}
+
+int assets_bake_decoded(
+        const AssetsSource* source, AtlasDecode* sprites, AtlasDecode* captions, const char* path) {
+    if (source->ncaptions + 1 > ASSETS_MAX_PAGES) {
+        ERROR("Too many captions to bake [count=%d]", source->ncaptions);
+        return 1;
+    }
+
+    AssetsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSETS_MAGIC, sizeof(header.magic));
+    header.version = ASSETS_VERSION;
+    header.header_size = sizeof(AssetsHeader);
+    header.source_hash = source_hash(source);
+
+    SDL_Surface* pages[ASSETS_MAX_PAGES];
+    memset(pages, 0, sizeof(pages));
+    SDL_Rect rects[ATLAS_MAX_IMAGES];
+    pages[0] = atlas_compose(sprites, rects);
+    int status = pages[0] == NULL;
+    if (status == 0) {
+        header.npages = 1 + source->ncaptions;
+        header.nplaced = source->nsprites;
+        header.pages[0] = (AssetsRect){TEXTURE_ATLAS, 0, 0, pages[0]->w, pages[0]->h};
+        for (uint8_t r = 0; r < source->nsprites; r += 1) {
+            SDL_Rect* rect = &rects[r];
+            header.placed[r] =
+                (AssetsRect){source->sprites[r].texture_id, rect->x, rect->y, rect->w, rect->h};
+        }
+    }
+    for (uint8_t r = 0; status == 0 && r < source->ncaptions; r += 1) {
+        /* Whatever format the PNG decoded to, the file holds RGBA32. */
+        SDL_Surface* page =
+            SDL_ConvertSurfaceFormat(captions->surfaces[r], SDL_PIXELFORMAT_RGBA32, 0);
+        if (page == NULL) {
+            ERROR("SDL_ConvertSurfaceFormat (%s)", source->captions[r].name);
+            status = 1;
+            break;
+        }
+        pages[1 + r] = page;
+        header.pages[1 + r] = (AssetsRect){source->captions[r].texture_id, 0, 0, page->w, page->h};
+    }
+
+    if (status == 0) {
+        status = assets_write(path, &header, pages, header.npages);
+    }
+
+    for (uint32_t r = 0; r < ASSETS_MAX_PAGES; r += 1) {
+        if (pages[r] != NULL) {
+            SDL_FreeSurface(pages[r]);
+        }
+    }
+    return status;
+}
+
+int assets_bake(const AssetsSource* source, const char* path) {
+    AtlasDecode sprites;
+    AtlasDecode captions;
+    int status = atlas_decode_start(&sprites, source->sprites, source->nsprites, true);
+    if (status == 0) {
+        status = atlas_decode_start(&captions, source->captions, source->ncaptions, false);
+    } else {
+        memset(&captions, 0, sizeof(captions));
+    }
+    if (status == 0) {
+        status = atlas_decode_wait(&sprites) | atlas_decode_wait(&captions);
+    }
+    if (status == 0) {
+        status = assets_bake_decoded(source, &sprites, &captions, path);
+    }
+    atlas_decode_free(&sprites);
+    atlas_decode_free(&captions);
+    return status;
+}
+
+static bool rect_valid(const AssetsRect* rect) {
+    return rect->texture_id >= 0 && rect->texture_id < TEXTURE_COUNT
+        && rect->w > 0 && rect->w <= ASSETS_MAX_SIZE && rect->h > 0 && rect->h <= ASSETS_MAX_SIZE
+        && rect->x >= 0 && rect->y >= 0;
+}
+
+/*
+ Returns: Whether the header describes a file of size bytes baked from source.
+ */
+static bool header_valid(const AssetsHeader* header, size_t size, const AssetsSource* source) {
+    if (memcmp(header->magic, ASSETS_MAGIC, sizeof(header->magic)) != 0
+            || header->version != ASSETS_VERSION
+            || header->header_size != sizeof(AssetsHeader)
+            || header->file_size != size
+            || header->npages != 1 + (uint32_t)source->ncaptions
+            || header->nplaced != source->nsprites
+            || header->pages[0].texture_id != TEXTURE_ATLAS) {
+        return false;
+    }
+
+    uint64_t expected = sizeof(AssetsHeader);
+    for (uint32_t r = 0; r < header->npages; r += 1) {
+        const AssetsRect* page = &header->pages[r];
+        if (!rect_valid(page)) {
+            return false;
+        }
+        if (r > 0 && page->texture_id != source->captions[r - 1].texture_id) {
+            return false;
+        }
+        expected += (uint64_t)page->w * page->h * 4;
+    }
+    for (uint32_t r = 0; r < header->nplaced; r += 1) {
+        const AssetsRect* placed = &header->placed[r];
+        if (!rect_valid(placed) || placed->texture_id != source->sprites[r].texture_id
+                || placed->x + placed->w > header->pages[0].w
+                || placed->y + placed->h > header->pages[0].h) {
+            return false;
+        }
+    }
+    /* Last since it reads all of the PNGs. */
+    return expected == size && header->source_hash == source_hash(source);
+}
+
+static void pages_free(State* state, const AssetsHeader* header, uint32_t npages) {
+    for (uint32_t r = 0; r < npages; r += 1) {
+        TexID texture_id = (TexID)header->pages[r].texture_id;
+        if (state->textures[texture_id] != NULL) {
+            SDL_DestroyTexture(state->textures[texture_id]);
+            state->textures[texture_id] = NULL;
+        }
+    }
+}
+
+/*
+ Returns: 0 if every page was uploaded into the texture it's for
+ */
+static int pages_upload(State* state, const AssetsHeader* header, const uint8_t* pixels) {
+    for (uint32_t r = 0; r < header->npages; r += 1) {
+        const AssetsRect* page = &header->pages[r];
+        SDL_Texture* texture = SDL_CreateTexture(state->renderer, SDL_PIXELFORMAT_RGBA32,
+            SDL_TEXTUREACCESS_STATIC, page->w, page->h);
+        if (texture == NULL) {
+            ERROR("SDL_CreateTexture (assets)");
+            pages_free(state, header, r);
+            return 1;
+        }
+        state->textures[page->texture_id] = texture;
+        if (SDL_UpdateTexture(texture, NULL, pixels, page->w * 4) != 0) {
+            ERROR("SDL_UpdateTexture (assets)");
+            pages_free(state, header, r + 1);
+            return 1;
+        }
+        if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) != 0) {
+            WARN("SDL_SetTextureBlendMode");
+        }
+        pixels += (size_t)page->w * page->h * 4;
+    }
+    return 0;
+}
+
+/*
+ Maps the file at path into memory, setting size to its size.
+ Returns: The mapping, to munmap() when done, or NULL if there isn't a file that's big enough.
+ */
+static void* assets_map(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        INFO("No baked assets at %s.", path);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(AssetsHeader)) {
+        WARN("%s isn't baked assets.", path);
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)info.st_size;
+    void* map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        WARN("Couldn't map %s.", path);
+        return NULL;
+    }
+    return map;
+}
+
+int assets_check(const AssetsSource* source, const char* path) {
+    size_t size;
+    void* map = assets_map(path, &size);
+    if (map == NULL) {
+        return 1;
+    }
+    int status = header_valid((const AssetsHeader*)map, size, source) ? 0 : 1;
+    munmap(map, size);
+    return status;
+}
+
+int assets_load(State* state, const AssetsSource* source, const char* path) {
+    if (state->renderer == NULL) {
+        ERROR("Renderer not initialized.");
+        return 1;
+    }
+
+    size_t size;
+    void* map = assets_map(path, &size);
+    if (map == NULL) {
+        return 1;
+    }
+
+    const AssetsHeader* header = (const AssetsHeader*)map;
+    int status = 1;
+    if (!header_valid(header, size, source)) {
+        WARN("%s wasn't baked from these images.", path);
+    } else {
+        status = pages_upload(state, header, (const uint8_t*)map + sizeof(AssetsHeader));
+    }
+    if (status == 0) {
+        for (uint32_t r = 0; r < header->nplaced; r += 1) {
+            const AssetsRect* placed = &header->placed[r];
+            state->atlas_rects[placed->texture_id] =
+                (SDL_Rect){placed->x, placed->y, placed->w, placed->h};
+        }
+    }
+
+    munmap(map, size);
+    return status;
+}
+
+/* Baked by ./start.sh next to the executable. */
+#define ASSETS_FILE "assets.bin"
+
+/*
+ Returns: 0 if the textures were uploaded from the baked assets, which skips decoding the PNGs.
+ */
+static int assets_baked(State* state, const AssetsSource* source) {
+    char* base = SDL_GetBasePath();
+    if (base == NULL) {
+        WARN("SDL_GetBasePath");
+        return 1;
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s", base, ASSETS_FILE);
+    SDL_free(base);
+    return assets_load(state, source, path);
+}
+
+int assets_init(State* state, const AssetsSource* source) {
+    state->assets = source;
+    bool baked = assets_baked(state, source) == 0;
+    if (!baked && atlas_load(state, source->sprites, source->nsprites) != 0) {
+        ERROR("atlas_load");
+        return 1;
+    }
+    
+    icon_texture_init(state, ICON_DRAGON, TEXTURE_DRAGON);
+    icon_texture_init(state, ICON_KNIGHT, TEXTURE_KNIGHT);
+    icon_texture_init(state, ICON_MKNIGHT, TEXTURE_MKNIGHT);
+    icon_texture_init(state, ICON_SHEEP, TEXTURE_SHEEP);
+    icon_texture_init(state, ICON_DOG, TEXTURE_DOG);
+    icon_texture_init(state, ICON_HORSE, TEXTURE_HORSE);
+    icon_texture_init(state, ICON_COOLDOWN, TEXTURE_COOLDOWN);
+
+    if (baked) {
+        /* Uploaded already so there's nothing to wait for. */
+        text_icons_init(state);
+        draw_loading_done();
+        return 0;
+    }
+    if (atlas_decode_start(&state->captions, source->captions, source->ncaptions, false) != 0) {
+        /* The game is still playable without them. */
+        WARN("atlas_decode_start (captions)");
+        draw_loading_done();
+    }
+    return 0;
+}
+
+int assets_reset(State* state) {
+    /* The renderer took every texture with it, the uploaded ones and the render targets alike. */
+    text_invalidate(state);
+    atlas_decode_free(&state->captions);
+    for (TexID r = 0; r < TEXTURE_COUNT; r += 1) {
+        if (state->textures[r] != NULL) {
+            SDL_DestroyTexture(state->textures[r]);
+            state->textures[r] = NULL;
+        }
+    }
+    memset(state->atlas_rects, 0, sizeof(state->atlas_rects));
+    batch_init(state);
+
+    if (state->assets == NULL) {
+        ERROR("Assets were never loaded.");
+        return 1;
+    }
+    if (assets_init(state, state->assets) != 0) {
+        return 1;
+    }
+    if (terrain_init(state) != 0) {
+        return 1;
+    }
+    if (draw_init(state) != 0) {
+        return 1;
+    }
+    if (terrain_update(state) != 0) {
+        WARN("terrain_update");
+    }
+    redraw(state);
+    return 0;
+}
+
+int assets_main(const AssetsSource* source, int argc, char* argv[]) {
+    if (argc < 1) {
+        ERROR("Usage: bake FILE");
+        return 1;
+    }
+    uint32_t start_ticks = SDL_GetTicks();
+    if (assets_check(source, argv[0]) == 0) {
+        printf("%s is up to date.\n", argv[0]);
+        return 0;
+    }
+    if (assets_bake(source, argv[0]) != 0) {
+        return 1;
+    }
+    printf("Baked %d images into %s. Took %ums.\n", source->nsprites + source->ncaptions,
+        argv[0], SDL_GetTicks() - start_ticks);
+    return 0;
+}
@@ -0,0 +1,44 @@
+
+/*
+ Decodes the images and writes them to path as raw pixels that assets_load() can upload without
+ decoding anything.
+ Returns: 0 if successful
+ */
+int assets_bake(const AssetsSource* source, const char* path);
+
+/*
+ Writes images that are already decoded, in the same order as in source, the way assets_bake()
+ does after decoding them.
+ Returns: 0 if successful
+ */
+int assets_bake_decoded(
+    const AssetsSource* source, AtlasDecode* sprites, AtlasDecode* captions, const char* path);
+
+/*
+ Returns: 0 if path holds assets baked from source that assets_load() would accept
+ */
+int assets_check(const AssetsSource* source, const char* path);
+
+/*
+ Uploads the textures baked from source into path, or does nothing if the file is missing or was
+ baked from different images.
+ Returns: 0 if every texture was loaded, else 1 and the PNGs have to be decoded instead
+ */
+int assets_load(State* state, const AssetsSource* source, const char* path);
+
+/*
+ Loads the textures and points the icons at them, from the baked assets next to the executable if
+ they're there and from the PNGs in source if not. The captions might only be decoded in the
+ background. See text_poll()
+ Returns: 0 if successful
+ */
+int assets_init(State* state, const AssetsSource* source);
+
+/*
+ Creates every texture again after the renderer lost them all to a device reset: the loaded
+ images as well as the terrain and frame buffers.
+ Returns: 0 if successful
+ */
+int assets_reset(State* state);
+
+int assets_main(const AssetsSource* source, int argc, char* argv[]);
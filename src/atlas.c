@@ -0,0 +1,256 @@
+#include "SDL.h"
+#include "SDL_image.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "draw.h"
+#include "event.h"
+#include "atlas.h"
+
+#define ATLAS_WIDTH 1024
+#define ATLAS_PADDING 2 /* Keeps neighbors from bleeding in when an image is drawn scaled. */
+
+int atlas_pack(SDL_Rect* rects, uint8_t count, int32_t width, int32_t* height) {
+    /* Tallest first so that each shelf wastes little height. */
+    uint8_t order[UINT8_MAX];
+    for (uint8_t r = 0; r < count; r += 1) {
+        uint8_t index = r;
+        while (index > 0 && rects[order[index - 1]].h < rects[r].h) {
+            order[index] = order[index - 1];
+            index -= 1;
+        }
+        order[index] = r;
+    }
+
+    int32_t x = 0;
+    int32_t shelf_y = 0;
+    int32_t shelf_h = 0;
+    for (uint8_t r = 0; r < count; r += 1) {
+        SDL_Rect* rect = &rects[order[r]];
+        if (rect->w > width) {
+            ERROR("Image is wider than the atlas [w=%d]", rect->w);
+            return 1;
+        }
+        if (x + rect->w > width) {
+            x = 0;
+            shelf_y += shelf_h + ATLAS_PADDING;
+            shelf_h = 0;
+        }
+        rect->x = x;
+        rect->y = shelf_y;
+        x += rect->w + ATLAS_PADDING;
+        if (rect->h > shelf_h) {
+            shelf_h = rect->h;
+        }
+    }
+    *height = shelf_y + shelf_h;
+    return 0;
+}
+
+static void surfaces_free(SDL_Surface** surfaces, uint8_t count) {
+    for (uint8_t r = 0; r < count; r += 1) {
+        if (surfaces[r] != NULL) {
+            SDL_FreeSurface(surfaces[r]);
+            surfaces[r] = NULL;
+        }
+    }
+}
+
+/*
+ Decodes images until there are none left to claim. Runs on the workers and on whoever waits for
+ them.
+ */
+static void decode_work(AtlasDecode* decode) {
+    while (true) {
+        int index = SDL_AtomicAdd(&decode->next, 1);
+        if (index >= decode->count) {
+            return;
+        }
+        const AtlasImage* image = &decode->images[index];
+        decode->surfaces[index] = const_png_to_surface(image->mem, (int)image->size);
+    }
+}
+
+static int decode_worker(void* data) {
+    AtlasDecode* decode = (AtlasDecode*)data;
+    decode_work(decode);
+    SDL_AtomicAdd(&decode->finished, 1);
+    events_wake();
+    return 0;
+}
+
+int atlas_decode_start(
+        AtlasDecode* decode, const AtlasImage* images, uint8_t count, bool caller_helps) {
+    memset(decode, 0, sizeof(AtlasDecode));
+    if (count > ATLAS_MAX_IMAGES) {
+        ERROR("Too many images to decode [count=%d]", count);
+        return 1;
+    }
+    /* Not safe to do from the workers. */
+    if (IMG_Init(0) == 0) {
+        if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0) {
+            ERROR("IMG_Init");
+            return 1;
+        }
+    }
+    decode->images = images;
+    decode->count = count;
+    decode->started = true;
+
+    int32_t nthreads = SDL_GetCPUCount();
+    if (caller_helps) {
+        nthreads -= 1;
+    }
+    if (nthreads > count) {
+        nthreads = count;
+    }
+    if (nthreads > ATLAS_MAX_THREADS) {
+        nthreads = ATLAS_MAX_THREADS;
+    }
+    for (int32_t r = 0; r < nthreads; r += 1) {
+        SDL_Thread* thread = SDL_CreateThread(decode_worker, "decode", decode);
+        if (thread == NULL) {
+            /* Whoever waits decodes what's left. */
+            WARN("SDL_CreateThread");
+            break;
+        }
+        decode->threads[decode->nthreads] = thread;
+        decode->nthreads += 1;
+    }
+    return 0;
+}
+
+bool atlas_decode_ready(AtlasDecode* decode) {
+    return decode->started && SDL_AtomicGet(&decode->finished) == decode->nthreads;
+}
+
+static void decode_join(AtlasDecode* decode) {
+    decode_work(decode);
+    for (uint8_t r = 0; r < decode->nthreads; r += 1) {
+        SDL_WaitThread(decode->threads[r], NULL);
+    }
+    decode->nthreads = 0;
+    SDL_AtomicSet(&decode->finished, 0);
+}
+
+int atlas_decode_wait(AtlasDecode* decode) {
+    if (!decode->started) {
+        return 1;
+    }
+    decode_join(decode);
+
+    int status = 0;
+    for (uint8_t r = 0; r < decode->count; r += 1) {
+        if (decode->surfaces[r] == NULL) {
+            ERROR("const_png_to_surface (%s)", decode->images[r].name);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+void atlas_decode_free(AtlasDecode* decode) {
+    if (!decode->started) {
+        return;
+    }
+    decode_join(decode);
+    surfaces_free(decode->surfaces, decode->count);
+    decode->started = false;
+}
+
+SDL_Surface* atlas_compose(AtlasDecode* decode, SDL_Rect* rects) {
+    uint8_t count = decode->count;
+    SDL_Surface** surfaces = decode->surfaces;
+    for (uint8_t r = 0; r < count; r += 1) {
+        rects[r] = (SDL_Rect){0, 0, surfaces[r]->w, surfaces[r]->h};
+    }
+
+    int32_t height;
+    if (atlas_pack(rects, count, ATLAS_WIDTH, &height) != 0) {
+        return NULL;
+    }
+
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(
+        0, ATLAS_WIDTH, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (atlas == NULL) {
+        ERROR("SDL_CreateRGBSurfaceWithFormat");
+        return NULL;
+    }
+    for (uint8_t r = 0; r < count; r += 1) {
+        /* Copy the alpha channel as it is instead of blending onto the empty atlas. */
+        if (SDL_SetSurfaceBlendMode(surfaces[r], SDL_BLENDMODE_NONE) != 0) {
+            WARN("SDL_SetSurfaceBlendMode");
+        }
+        SDL_Rect dest_rect = rects[r];
+        if (SDL_BlitSurface(surfaces[r], NULL, atlas, &dest_rect) != 0) {
+            ERROR("SDL_BlitSurface (%s)", decode->images[r].name);
+            SDL_FreeSurface(atlas);
+            return NULL;
+        }
+    }
+    return atlas;
+}
+
+/*
+ Packs the decoded surfaces into one texture.
+ Returns: 0 if successful
+ */
+static int atlas_build(State* state, AtlasDecode* decode) {
+    SDL_Rect rects[ATLAS_MAX_IMAGES];
+    SDL_Surface* atlas = atlas_compose(decode, rects);
+    if (atlas == NULL) {
+        return 1;
+    }
+    for (uint8_t r = 0; r < decode->count; r += 1) {
+        state->atlas_rects[decode->images[r].texture_id] = rects[r];
+    }
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(state->renderer, atlas);
+    SDL_FreeSurface(atlas);
+    if (texture == NULL) {
+        ERROR("SDL_CreateTextureFromSurface");
+        return 1;
+    }
+    if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) != 0) {
+        WARN("SDL_SetTextureBlendMode");
+    }
+    state->textures[TEXTURE_ATLAS] = texture;
+    return 0;
+}
+
+int atlas_load(State* state, const AtlasImage* images, uint8_t count) {
+    if (state->renderer == NULL) {
+        ERROR("Renderer not initialized.");
+        return 1;
+    }
+
+    AtlasDecode decode;
+    int status = atlas_decode_start(&decode, images, count, true);
+    if (status == 0) {
+        status = atlas_decode_wait(&decode);
+    }
+    if (status == 0) {
+        status = atlas_build(state, &decode);
+    }
+    atlas_decode_free(&decode);
+    return status;
+}
+
+int atlas_upload(State* state, AtlasDecode* decode) {
+    if (atlas_decode_wait(decode) != 0) {
+        return 1;
+    }
+    for (uint8_t r = 0; r < decode->count; r += 1) {
+        TexID texture_id = decode->images[r].texture_id;
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(state->renderer, decode->surfaces[r]);
+        if (texture == NULL) {
+            ERROR("SDL_CreateTextureFromSurface (%s)", decode->images[r].name);
+            return 1;
+        }
+        if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) != 0) {
+            WARN("SDL_SetTextureBlendMode");
+        }
+        state->textures[texture_id] = texture;
+    }
+    return 0;
+}
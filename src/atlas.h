@@ -0,0 +1,51 @@
+
+/*
+ Arranges rectangles of the given sizes into shelves no wider than width, setting the x and y of
+ each one.
+ Returns: 0 if successful, with height set to the height that they take up.
+ */
+int atlas_pack(SDL_Rect* rects, uint8_t count, int32_t width, int32_t* height);
+
+/*
+ Starts decoding the images into surfaces on worker threads, one per core at most. With
+ caller_helps it leaves a core for the caller, which is about to decode too by waiting.
+ Returns: 0 if successful
+ */
+int atlas_decode_start(
+    AtlasDecode* decode, const AtlasImage* images, uint8_t count, bool caller_helps);
+
+/*
+ Returns: Whether the workers are done, so waiting for them won't block.
+ */
+bool atlas_decode_ready(AtlasDecode* decode);
+
+/*
+ Decodes whatever images the workers haven't gotten to and waits for them to finish.
+ Returns: 0 if every image was decoded
+ */
+int atlas_decode_wait(AtlasDecode* decode);
+
+/*
+ Waits for the workers and frees the surfaces. Safe to call on a decode that never started.
+ */
+void atlas_decode_free(AtlasDecode* decode);
+
+/*
+ Packs the decoded images into one RGBA32 surface, setting rects to where each one went.
+ Returns: A newly allocated SDL_Surface, owned by the caller, or NULL if there was an error.
+ */
+SDL_Surface* atlas_compose(AtlasDecode* decode, SDL_Rect* rects);
+
+/*
+ Waits for the images to decode and uploads each one into a texture of its own.
+ Returns: 0 if successful
+ */
+int atlas_upload(State* state, AtlasDecode* decode);
+
+/*
+ Decodes the images in parallel and packs them all into the one texture TEXTURE_ATLAS so that
+ drawing a frame doesn't keep switching textures. Records where each one went in
+ state->atlas_rects so that the icons initialized afterward point into the atlas.
+ Returns: 0 if successful
+ */
+int atlas_load(State* state, const AtlasImage* images, uint8_t count);
@@ -0,0 +1,100 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "draw.h"
+#include "render.h"
+#include "batch.h"
+
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+#error "SDL 2.0.18 or later is needed for SDL_RenderGeometry."
+#endif
+
+void batch_init(State* state) {
+    Batch* batch = &state->batch;
+    batch->texture_id = -1;
+    batch->nquads = 0;
+    for (uint32_t r = 0; r < BATCH_MAX_QUADS; r += 1) {
+        /* Two triangles per quad: top left, top right, bottom right and bottom left. */
+        int* indices = &batch->indices[r * 6];
+        int first = (int)(r * 4);
+        indices[0] = first;
+        indices[1] = first + 1;
+        indices[2] = first + 2;
+        indices[3] = first;
+        indices[4] = first + 2;
+        indices[5] = first + 3;
+    }
+    for (TexID r = 0; r < TEXTURE_COUNT; r += 1) {
+        batch->mods[r] = (SDL_Color){255, 255, 255, 255};
+    }
+}
+
+void batch_flush(State* state) {
+    Batch* batch = &state->batch;
+    if (batch->nquads == 0) {
+        return;
+    }
+    SDL_Texture* texture = draw_get_texture(state, batch->texture_id);
+    if (texture != NULL && SDL_RenderGeometry(state->renderer, texture, batch->vertices,
+            (int)(batch->nquads * 4), batch->indices, (int)(batch->nquads * 6)) != 0) {
+        WARN("SDL_RenderGeometry");
+    }
+    render_count_draw(state, texture);
+    batch->nquads = 0;
+}
+
+void batch_mod(State* state, TexID texture_id, SDL_Color color) {
+    if (texture_id < 0 || texture_id >= TEXTURE_COUNT) {
+        WARN("Invalid texture ID.");
+        return;
+    }
+    state->batch.mods[texture_id] = color;
+}
+
+static SDL_Vertex vertex(float_t x, float_t y, SDL_Color color, float_t u, float_t v) {
+    SDL_Vertex result = {
+        .position = {x, y},
+        .color = color,
+        .tex_coord = {u, v},
+    };
+    return result;
+}
+
+void batch_add(State* state, TexID texture_id, const SDL_Rect* source_rect,
+        const SDL_Rect* dest_rect, SDL_Color color) {
+    Batch* batch = &state->batch;
+    if (texture_id != batch->texture_id || batch->nquads >= BATCH_MAX_QUADS) {
+        batch_flush(state);
+
+        SDL_Texture* texture = draw_get_texture(state, texture_id);
+        if (texture == NULL) {
+            return;
+        }
+        int w, h;
+        if (SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0 || w <= 0 || h <= 0) {
+            ERROR("SDL_QueryTexture");
+            return;
+        }
+        batch->texture_id = texture_id;
+        batch->texture_w = (float_t)w;
+        batch->texture_h = (float_t)h;
+    }
+
+    float_t left = (float_t)source_rect->x / batch->texture_w;
+    float_t top = (float_t)source_rect->y / batch->texture_h;
+    float_t right = (float_t)(source_rect->x + source_rect->w) / batch->texture_w;
+    float_t bottom = (float_t)(source_rect->y + source_rect->h) / batch->texture_h;
+
+    float_t x0 = (float_t)dest_rect->x;
+    float_t y0 = (float_t)dest_rect->y;
+    float_t x1 = (float_t)(dest_rect->x + dest_rect->w);
+    float_t y1 = (float_t)(dest_rect->y + dest_rect->h);
+
+    SDL_Vertex* vertices = &batch->vertices[batch->nquads * 4];
+    vertices[0] = vertex(x0, y0, color, left, top);
+    vertices[1] = vertex(x1, y0, color, right, top);
+    vertices[2] = vertex(x1, y1, color, right, bottom);
+    vertices[3] = vertex(x0, y1, color, left, bottom);
+    batch->nquads += 1;
+}
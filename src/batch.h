@@ -0,0 +1,22 @@
+
+void batch_init(State* state);
+
+/*
+ Queues a sprite to be drawn with the others that use the same texture, multiplied by color. The
+ queue is drawn all at once when a sprite from a different texture comes along, when it fills up
+ or when batch_flush() is called.
+ */
+void batch_add(State* state, TexID texture_id, const SDL_Rect* source_rect,
+    const SDL_Rect* dest_rect, SDL_Color color);
+
+/*
+ Draws the queued sprites. Has to be called before drawing anything without the batch, switching
+ render targets or presenting so that things stay in order.
+ */
+void batch_flush(State* state);
+
+/*
+ Sets the color and alpha that sprites drawn from the texture from now on are multiplied by. See
+ draw_texture()
+ */
+void batch_mod(State* state, TexID texture_id, SDL_Color color);
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "SDL.h"
 #include "logging.h"
 #include "entity.h"
@@ -6,272 +7,504 @@
 #include "icon.h"
 #include "terrain.h"
 #include "draw.h"
-
-#define LEVEL_MAX 3
+#include "board.h"
+#include "hint.h"
+#include "ai.h"
+#include "route.h"
+#include "preview.h"
+#include "doom.h"
 
 bool in_board(Coord tile_x, Coord tile_y) {
     return tile_x >= 0 && tile_y >= 0 && tile_x < TILES_ACROSS && tile_y < TILES_DOWN;
 }
 
-static void make_generic_piece(State* state, Entity entity, int32_t x, int32_t y, IconID icon_id) {
-    if (position_init(&state->components, entity, x, y) == NULL) {
+static void make_generic_piece(
+        Components* comps, Entity entity, int32_t x, int32_t y, IconID icon_id) {
+    if (position_init(comps, entity, x, y) == NULL) {
         WARN("position_init");
     }
-    if (avatar_init(&state->components, entity, icon_id, (float_t)x, (float_t)y) == NULL) {
+    if (avatar_init(comps, entity, icon_id, (float_t)x, (float_t)y) == NULL) {
         WARN("avatar_init");
     }
-    if (selectable_init(&state->components, entity) == NULL) {
+    if (selectable_init(comps, entity) == NULL) {
         WARN("selectable_init");
     }
-    if (obstruction_init(&state->components, entity) == NULL) {
+    if (obstruction_init(comps, entity) == NULL) {
         WARN("obstruction_init");
     }
-    if (tween_init(&state->components, entity) == NULL) {
+    if (tween_init(comps, entity) == NULL) {
         WARN("tween_init");
     }
 }
 
-static void make_sheep(State* state, Entity entity, int32_t x, int32_t y) {
-    if (position_init(&state->components, entity, x, y) == NULL) {
+void make_dragon(Components* comps, Entity entity, int32_t x, int32_t y) {
+    make_generic_piece(comps, entity, x, y, ICON_DRAGON);
+    munch_init(comps, entity);
+    slayme_init(comps, entity);
+}
+
+void make_knight(Components* comps, Entity entity, int32_t x, int32_t y) {
+    make_generic_piece(comps, entity, x, y, ICON_KNIGHT);
+    rider_init(comps, entity);
+    edible_init(comps, entity);
+}
+
+void make_mounted_knight(Components* comps, Entity entity, int32_t x, int32_t y) {
+    make_generic_piece(comps, entity, x, y, ICON_MKNIGHT);
+    slayer_init(comps, entity);
+    edible_init(comps, entity);
+}
+
+void make_horse(Components* comps, Entity entity, int32_t x, int32_t y) {
+    make_generic_piece(comps, entity, x, y, ICON_HORSE);
+    mount_init(comps, entity);
+    edible_init(comps, entity);
+}
+
+void make_dog(Components* comps, Entity entity, int32_t x, int32_t y) {
+    make_generic_piece(comps, entity, x, y, ICON_DOG);
+    edible_init(comps, entity);
+    herder_init(comps, entity);
+}
+
+void make_sheep(Components* comps, Entity entity, int32_t x, int32_t y) {
+    if (position_init(comps, entity, x, y) == NULL) {
         WARN("position_init");
     }
-    if (avatar_init(&state->components, entity, ICON_SHEEP, (float_t)x, (float_t)y) == NULL) {
+    if (avatar_init(comps, entity, ICON_SHEEP, (float_t)x, (float_t)y) == NULL) {
         WARN("avatar_init");
     }
-    if (obstruction_init(&state->components, entity) == NULL) {
+    if (obstruction_init(comps, entity) == NULL) {
         WARN("obstruction_init");
     }
-    if (edible_init(&state->components, entity) == NULL) {
+    if (edible_init(comps, entity) == NULL) {
         WARN("edible_init");
     }
-    if (flock_init(&state->components, entity) == NULL) {
+    if (flock_init(comps, entity) == NULL) {
         WARN("flock_init");
     }
-    if (tween_init(&state->components, entity) == NULL) {
+    if (tween_init(comps, entity) == NULL) {
         WARN("tween_init");
     }
 }
 
-static void make_wall(State* state, Entity entity, int32_t x, int32_t y, IconID icon_id) {
-    if (position_init(&state->components, entity, x, y) == NULL) {
+void make_wall(Components* comps, Entity entity, int32_t x, int32_t y, IconID icon_id) {
+    if (position_init(comps, entity, x, y) == NULL) {
         WARN("position_init");
     }
-    if (obstruction_init(&state->components, entity) == NULL) {
+    if (obstruction_init(comps, entity) == NULL) {
         WARN("obstruction_init");
     }
-    if (tile_init(&state->components, entity, icon_id) == NULL) {
+    if (tile_init(comps, entity, icon_id) == NULL) {
         WARN("tile_init");
     }
 }
 
-static void level_2_init(State* state) {
+static void level_2_init(Components* comps) {
     /* Pieces. */
     
     Entity entity = 1; /* TODO: function to get next entity */
-    make_generic_piece(state, entity, 2, 0, ICON_DRAGON);
-    munch_init(&state->components, entity);
-    slayme_init(&state->components, entity);
+    make_dragon(comps, entity, 2, 0);
     
     entity += 1;
-    make_generic_piece(state, entity, 4, 4, ICON_KNIGHT);
-    rider_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_knight(comps, entity, 4, 4);
     
     entity += 1;
-    make_sheep(state, entity, 4, 1);
+    make_sheep(comps, entity, 4, 1);
     
     entity += 1;
-    make_sheep(state, entity, 2, 3);
+    make_sheep(comps, entity, 2, 3);
     
     entity += 1;
-    make_sheep(state, entity, 5, 0);
+    make_sheep(comps, entity, 5, 0);
     
     entity += 1;
-    make_generic_piece(state, entity, 4, 2, ICON_HORSE);
-    mount_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_horse(comps, entity, 4, 2);
     
     entity += 1;
-    make_generic_piece(state, entity, 7, 3, ICON_DOG);
-    edible_init(&state->components, entity);
-    herder_init(&state->components, entity);
+    make_dog(comps, entity, 7, 3);
 
     /* Terrain. */
     
     entity += 1;
-    make_wall(state, entity, 0, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 5, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 0, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 5, ICON_PYRAMID);
 
     for (int32_t r = 1; r < 5; r += 1) {
         entity += 1;
-        make_wall(state, entity, 0, r, ICON_WALL);
+        make_wall(comps, entity, 0, r, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, 9, r, ICON_WALL);
+        make_wall(comps, entity, 9, r, ICON_WALL);
     }
     
     for (int32_t r = 1; r < 9; r += 1) {
         entity += 1;
-        make_wall(state, entity, r, 5, ICON_WALL);
+        make_wall(comps, entity, r, 5, ICON_WALL);
     }
     
     for (int32_t r = 7; r < 9; r += 1) {
         entity += 1;
-        make_wall(state, entity, r, 0, ICON_WALL);
+        make_wall(comps, entity, r, 0, ICON_WALL);
     }
     entity += 1;
-    make_wall(state, entity, 6, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 6, 0, ICON_PYRAMID);
     
     entity += 1;
-    make_wall(state, entity, 1, 3, ICON_PYRAMID);
+    make_wall(comps, entity, 1, 3, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 1, 4, ICON_WALL);
+    make_wall(comps, entity, 1, 4, ICON_WALL);
 }
 
-static void level_1_init(State* state) {
+static void level_1_init(Components* comps) {
     /* Pieces. */
     
     Entity entity = 1; /* TODO: function to get next entity */
-    make_generic_piece(state, entity, 3, 2, ICON_DRAGON);
-    munch_init(&state->components, entity);
-    slayme_init(&state->components, entity);
+    make_dragon(comps, entity, 3, 2);
     
     entity += 1;
-    make_generic_piece(state, entity, 6, 3, ICON_KNIGHT);
-    rider_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_knight(comps, entity, 6, 3);
     
     entity += 1;
-    make_generic_piece(state, entity, 5, 3, ICON_HORSE);
-    mount_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_horse(comps, entity, 5, 3);
     
     entity += 1;
-    make_sheep(state, entity, 7, 2);
+    make_sheep(comps, entity, 7, 2);
     
     /* Terrain. */
     
     entity += 1;
-    make_wall(state, entity, 0, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 5, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 0, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 5, ICON_PYRAMID);
 
     for (int32_t r = 1; r < 5; r += 1) {
         entity += 1;
-        make_wall(state, entity, 0, r, ICON_WALL);
+        make_wall(comps, entity, 0, r, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, 9, r, ICON_WALL);
+        make_wall(comps, entity, 9, r, ICON_WALL);
         
         entity += 1;
-        make_wall(state, entity, 1, r, ICON_WALL);
+        make_wall(comps, entity, 1, r, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, 8, r, ICON_WALL);
+        make_wall(comps, entity, 8, r, ICON_WALL);
     }
     
     for (int32_t r = 1; r < 9; r += 1) {
         entity += 1;
-        make_wall(state, entity, r, 5, ICON_WALL);
+        make_wall(comps, entity, r, 5, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, r, 0, ICON_WALL);
+        make_wall(comps, entity, r, 0, ICON_WALL);
     }
     
     for (int32_t r = 2; r < 8; r += 1) {
         entity += 1;
-        make_wall(state, entity, r, 4, ICON_WALL);
+        make_wall(comps, entity, r, 4, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, r, 1, ICON_WALL);
+        make_wall(comps, entity, r, 1, ICON_WALL);
     }
 }
 
-static void level_3_init(State* state) {
+static void level_3_init(Components* comps) {
     /* Pieces. */
     
     Entity entity = 1; /* TODO: function to get next entity */
-    make_generic_piece(state, entity, 4, 3, ICON_DRAGON);
-    munch_init(&state->components, entity);
-    slayme_init(&state->components, entity);
+    make_dragon(comps, entity, 4, 3);
     
     entity += 1;
-    make_generic_piece(state, entity, 3, 4, ICON_KNIGHT);
-    rider_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_knight(comps, entity, 3, 4);
     
     entity += 1;
-    make_generic_piece(state, entity, 5, 4, ICON_HORSE);
-    mount_init(&state->components, entity);
-    edible_init(&state->components, entity);
+    make_horse(comps, entity, 5, 4);
     
     entity += 1;
-    make_sheep(state, entity, 3, 1);
+    make_sheep(comps, entity, 3, 1);
     entity += 1;
-    make_sheep(state, entity, 5, 3);
+    make_sheep(comps, entity, 5, 3);
     entity += 1;
-    make_sheep(state, entity, 6, 1);
+    make_sheep(comps, entity, 6, 1);
     entity += 1;
-    make_sheep(state, entity, 1, 2);
+    make_sheep(comps, entity, 1, 2);
     
     entity += 1;
-    make_generic_piece(state, entity, 5, 1, ICON_DOG);
-    edible_init(&state->components, entity);
-    herder_init(&state->components, entity);
+    make_dog(comps, entity, 5, 1);
     
     /* Terrain. */
     
     entity += 1;
-    make_wall(state, entity, 0, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 0, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 0, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 9, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 9, 5, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 0, 5, ICON_PYRAMID);
+    make_wall(comps, entity, 0, 5, ICON_PYRAMID);
 
     
     entity += 1;
-    make_wall(state, entity, 6, 3, ICON_PYRAMID);
+    make_wall(comps, entity, 6, 3, ICON_PYRAMID);
     entity += 1;
-    make_wall(state, entity, 6, 4, ICON_WALL);
+    make_wall(comps, entity, 6, 4, ICON_WALL);
 
     for (int32_t r = 1; r < 5; r += 1) {
         entity += 1;
-        make_wall(state, entity, 0, r, ICON_WALL);
+        make_wall(comps, entity, 0, r, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, 9, r, ICON_WALL);
+        make_wall(comps, entity, 9, r, ICON_WALL);
     }
     
     for (int32_t r = 1; r < 9; r += 1) {
         entity += 1;
-        make_wall(state, entity, r, 5, ICON_WALL);
+        make_wall(comps, entity, r, 5, ICON_WALL);
         entity += 1;
-        make_wall(state, entity, r, 0, ICON_WALL);
+        make_wall(comps, entity, r, 0, ICON_WALL);
     }
 }
 
+int level_build(Components* comps, LevelID level_id) {
+    if (level_id == 1) {
+        level_1_init(comps);
+    } else if (level_id == 2) {
+        level_2_init(comps);
+    } else if (level_id == 3) {
+        level_3_init(comps);
+    } else {
+        WARN("Invalid level_id %d.", level_id);
+        return 1;
+    }
+    return 0;
+}
+
+const char* level_skip(const char* text) {
+    while (*text != '\0') {
+        if (*text == ';') {
+            while (*text != '\0' && *text != '\n') {
+                text += 1;
+            }
+        } else if (*text != '\n' && *text != '\r' && *text != ' ' && *text != '\t') {
+            break;
+        }
+        if (*text != '\0') {
+            text += 1;
+        }
+    }
+    return text;
+}
+
+int level_parse(Components* comps, const char* text, const char** end) {
+    text = level_skip(text);
+
+    char grid[TILES_DOWN][TILES_ACROSS];
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        for (int32_t x = 0; x < TILES_ACROSS; x += 1) {
+            if (*text == '\0' || *text == '\n' || *text == '\r') {
+                WARN("Level row %d is too short.", y);
+                return 1;
+            }
+            grid[y][x] = *text;
+            text += 1;
+        }
+        if (*text == '\r') {
+            text += 1;
+        }
+        if (*text == '\n') {
+            text += 1;
+        } else if (*text != '\0') {
+            WARN("Level row %d is too long.", y);
+            return 1;
+        }
+    }
+    if (end != NULL) {
+        *end = text;
+    }
+
+    /* Pieces get the lowest entity IDs like in the built-in levels. */
+    Entity entity = 0;
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        for (int32_t x = 0; x < TILES_ACROSS; x += 1) {
+            char c = grid[y][x];
+            if (c == LEVEL_CHAR_DRAGON) {
+                make_dragon(comps, ++entity, x, y);
+            } else if (c == LEVEL_CHAR_KNIGHT) {
+                make_knight(comps, ++entity, x, y);
+            } else if (c == LEVEL_CHAR_MKNIGHT) {
+                make_mounted_knight(comps, ++entity, x, y);
+            } else if (c == LEVEL_CHAR_HORSE) {
+                make_horse(comps, ++entity, x, y);
+            } else if (c == LEVEL_CHAR_DOG) {
+                make_dog(comps, ++entity, x, y);
+            } else if (c == LEVEL_CHAR_SHEEP) {
+                make_sheep(comps, ++entity, x, y);
+            } else if (c != LEVEL_CHAR_FLOOR && c != LEVEL_CHAR_WALL && c != LEVEL_CHAR_PYRAMID) {
+                WARN("Unknown level character '%c'.", c);
+                return 1;
+            }
+        }
+    }
+
+    /* Terrain. */
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        for (int32_t x = 0; x < TILES_ACROSS; x += 1) {
+            char c = grid[y][x];
+            if (c == LEVEL_CHAR_WALL) {
+                make_wall(comps, ++entity, x, y, ICON_WALL);
+            } else if (c == LEVEL_CHAR_PYRAMID) {
+                make_wall(comps, ++entity, x, y, ICON_PYRAMID);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static char level_char_of(Components* comps, Entity entity) {
+    if (component_of(&comps->compgroups[COMPTYPE_MUNCH], entity) != NULL) {
+        return LEVEL_CHAR_DRAGON;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_RIDER], entity) != NULL) {
+        return LEVEL_CHAR_KNIGHT;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_SLAYER], entity) != NULL) {
+        return LEVEL_CHAR_MKNIGHT;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_MOUNT], entity) != NULL) {
+        return LEVEL_CHAR_HORSE;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_HERDER], entity) != NULL) {
+        return LEVEL_CHAR_DOG;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_FLOCK], entity) != NULL) {
+        return LEVEL_CHAR_SHEEP;
+    }
+    CTile* tile = (CTile*)component_of(&comps->compgroups[COMPTYPE_TILE], entity);
+    if (tile != NULL) {
+        return tile->icon_id == ICON_PYRAMID ? LEVEL_CHAR_PYRAMID : LEVEL_CHAR_WALL;
+    }
+    return LEVEL_CHAR_FLOOR;
+}
+
+int level_format(Components* comps, char* buf, size_t size) {
+    if (size < LEVEL_TEXT_SIZE) {
+        ERROR("Level buffer too small.");
+        return 1;
+    }
+
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        for (int32_t x = 0; x < TILES_ACROSS; x += 1) {
+            buf[y * (TILES_ACROSS + 1) + x] = LEVEL_CHAR_FLOOR;
+        }
+        buf[y * (TILES_ACROSS + 1) + TILES_ACROSS] = '\n';
+    }
+    buf[LEVEL_TEXT_SIZE - 1] = '\0';
+
+    CompGroup* positions = &comps->compgroups[COMPTYPE_POSITION];
+    for (uint32_t r = 0; r < positions->alive; r += 1) {
+        CPosition* position = &((CPosition*)positions->mem)[r];
+        if (!in_board(position->x, position->y)) {
+            continue;
+        }
+        buf[position->y * (TILES_ACROSS + 1) + position->x] =
+            level_char_of(comps, position->entity);
+    }
+
+    return 0;
+}
+
+char* level_pack_load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        ERROR("Couldn't open level pack %s.", path);
+        return NULL;
+    }
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    char* text = malloc(capacity);
+    while (text != NULL) {
+        size += fread(text + size, 1, capacity - size - 1, file);
+        if (size < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        char* grown = realloc(text, capacity);
+        if (grown == NULL) {
+            free(text);
+        }
+        text = grown;
+    }
+    fclose(file);
+
+    if (text == NULL) {
+        ERROR("Out of memory loading level pack.");
+        return NULL;
+    }
+    text[size] = '\0';
+    return text;
+}
+
+LevelID level_pack_count(const char* text) {
+    LevelID count = 0;
+    Components scratch = components_new();
+    while (*level_skip(text) != '\0' && count < UINT8_MAX) {
+        components_clear(&scratch);
+        if (level_parse(&scratch, text, &text) != 0) {
+            break;
+        }
+        count += 1;
+    }
+    components_free(&scratch);
+    return count;
+}
+
+static int level_pack_build(Components* comps, const char* text, LevelID level_id) {
+    for (LevelID r = 1; r < level_id; r += 1) {
+        components_clear(comps);
+        if (level_parse(comps, text, &text) != 0) {
+            return 1;
+        }
+    }
+    components_clear(comps);
+    return level_parse(comps, text, NULL);
+}
+
+static LevelID level_max(State* state) {
+    if (state->level_pack != NULL) {
+        return state->level_count;
+    }
+    return LEVEL_MAX;
+}
+
 static void level_id_init(State* state, LevelID level_id) {
+    hint_cancel(state);
+    ai_cancel(state);
+    route_clear(state);
+    preview_clear(state);
+    doom_reset(&state->doom);
     components_clear(&state->components);
     state->level_id = level_id;
     state->game_over = false;
     state->won = false;
     
-    if (level_id == 1) {
-        level_1_init(state);
-    } else if (level_id == 2) {
-        level_2_init(state);
-    } else if (level_id == 3) {
-        level_3_init(state);
+    int status;
+    if (state->level_pack != NULL) {
+        status = level_pack_build(&state->components, state->level_pack, level_id);
     } else {
-        WARN("Invalid level_id %d.", level_id);
+        status = level_build(&state->components, level_id);
+    }
+    if (status != 0) {
+        WARN("Couldn't build level %d.", level_id);
         return;
     }
 
+    terrain_refresh(state);
     terrain_update(state);
     redraw(state);
 }
@@ -284,20 +517,20 @@ void level_restart(State* state) {
     level_id_init(state, state->level_id);
 }
 
-static LevelID wrap_level(LevelID level_id) {
+static LevelID wrap_level(State* state, int32_t level_id) {
     if (level_id <= 0) {
-        return LEVEL_MAX;
+        return level_max(state);
     }
-    if (level_id > LEVEL_MAX) {
+    if (level_id > level_max(state)) {
         return 1;
     }
     return level_id;
 }
 
 void level_next(State* state) {
-    level_id_init(state, wrap_level(state->level_id + 1));
+    level_id_init(state, wrap_level(state, state->level_id + 1));
 }
 
 void level_prev(State* state) {
-    level_id_init(state, wrap_level(state->level_id - 1));
+    level_id_init(state, wrap_level(state, state->level_id - 1));
 }
@@ -1,7 +1,74 @@
 
+/* Number of built-in levels. */
+#define LEVEL_MAX 3
+
+/*
+ Level text format: TILES_DOWN rows of TILES_ACROSS characters, one row per line. Lines starting
+ with ';' are comments. A level pack is any number of levels separated by blank lines or comments.
+ */
+#define LEVEL_CHAR_FLOOR '.'
+#define LEVEL_CHAR_WALL '#'
+#define LEVEL_CHAR_PYRAMID '^'
+#define LEVEL_CHAR_DRAGON 'D'
+#define LEVEL_CHAR_KNIGHT 'K'
+#define LEVEL_CHAR_MKNIGHT 'M'
+#define LEVEL_CHAR_HORSE 'H'
+#define LEVEL_CHAR_DOG 'C'
+#define LEVEL_CHAR_SHEEP 'S'
+
+/* Size of the buffer written by level_format(), including the terminator. */
+#define LEVEL_TEXT_SIZE (TILES_DOWN * (TILES_ACROSS + 1) + 1)
+
 bool in_board(Coord tile_x, Coord tile_y);
 
 void level_init(State* state);
 void level_restart(State* state);
 void level_next(State* state);
 void level_prev(State* state);
+
+/*
+ Piece archetypes. Each one attaches the components that make up that kind of piece.
+ */
+void make_dragon(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_knight(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_mounted_knight(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_horse(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_dog(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_sheep(Components* comps, Entity entity, int32_t x, int32_t y);
+void make_wall(Components* comps, Entity entity, int32_t x, int32_t y, IconID icon_id);
+
+/*
+ Adds the pieces and terrain of one of the built-in levels to comps.
+ Returns: 0 if successful
+ */
+int level_build(Components* comps, LevelID level_id);
+
+/*
+ Returns: text advanced past any blank lines and comments.
+ */
+const char* level_skip(const char* text);
+
+/*
+ Adds the pieces and terrain of the first level in text to comps.
+ end: If not NULL, set to the text following the level.
+ Returns: 0 if successful
+ */
+int level_parse(Components* comps, const char* text, const char** end);
+
+/*
+ Writes comps in the level text format.
+ size: Must be at least LEVEL_TEXT_SIZE.
+ Returns: 0 if successful
+ */
+int level_format(Components* comps, char* buf, size_t size);
+
+/*
+ Returns: The contents of the file as a newly allocated string, owned by the caller, or NULL if
+          there was an error.
+ */
+char* level_pack_load(const char* path);
+
+/*
+ Returns: The number of levels in the pack, up to the first level that doesn't parse.
+ */
+LevelID level_pack_count(const char* text);
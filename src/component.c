@@ -1,45 +1,160 @@
 #include "SDL.h"
+#include "logging.h"
 #include "entity.h"
 #include "constants.h"
+#include "component.h"
+
+static const uint32_t group_totals[COMPTYPE_COUNT] = {
+    [COMPTYPE_POSITION] = 60,
+    [COMPTYPE_AVATAR] = 10,
+    [COMPTYPE_SELECTABLE] = 10,
+    [COMPTYPE_MOUNT] = 10,
+    [COMPTYPE_RIDER] = 10,
+    [COMPTYPE_MUNCH] = 10,
+    [COMPTYPE_EDIBLE] = 10,
+    [COMPTYPE_SLAYER] = 10,
+    [COMPTYPE_SLAYME] = 10,
+    [COMPTYPE_OBSTRUCTION] = 60,
+    [COMPTYPE_TILE] = 60,
+    [COMPTYPE_HERDER] = 10,
+    [COMPTYPE_FLOCK] = 10,
+    [COMPTYPE_TWEEN] = 10,
+};
+
+static const size_t group_sizes[COMPTYPE_COUNT] = {
+    [COMPTYPE_POSITION] = sizeof(CPosition),
+    [COMPTYPE_AVATAR] = sizeof(CAvatar),
+    [COMPTYPE_SELECTABLE] = sizeof(CSelectable),
+    [COMPTYPE_MOUNT] = sizeof(CMount),
+    [COMPTYPE_RIDER] = sizeof(CRider),
+    [COMPTYPE_MUNCH] = sizeof(CMunch),
+    [COMPTYPE_EDIBLE] = sizeof(CEdible),
+    [COMPTYPE_SLAYER] = sizeof(CSlayer),
+    [COMPTYPE_SLAYME] = sizeof(CSlayMe),
+    [COMPTYPE_OBSTRUCTION] = sizeof(CObstruction),
+    [COMPTYPE_TILE] = sizeof(CTile),
+    [COMPTYPE_HERDER] = sizeof(CHerder),
+    [COMPTYPE_FLOCK] = sizeof(CFlock),
+    [COMPTYPE_TWEEN] = sizeof(CTween),
+};
+
+/* Keeps each group in components_new_in() aligned for any component type. */
+static size_t group_bytes(size_t r) {
+    size_t bytes = group_totals[r] * group_sizes[r];
+    return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+}
 
 Components components_new() {
     Components result;
-    result.compgroups[COMPTYPE_POSITION] = compgroup_init(60, sizeof(CPosition));
-    result.compgroups[COMPTYPE_AVATAR] = compgroup_init(10, sizeof(CAvatar));
-    result.compgroups[COMPTYPE_SELECTABLE] = compgroup_init(10, sizeof(CSelectable));
-    result.compgroups[COMPTYPE_MOUNT] = compgroup_init(1, sizeof(CMount));
-    result.compgroups[COMPTYPE_RIDER] = compgroup_init(1, sizeof(CRider));
-    result.compgroups[COMPTYPE_MUNCH] = compgroup_init(1, sizeof(CMunch));
-    result.compgroups[COMPTYPE_EDIBLE] = compgroup_init(10, sizeof(CEdible));
-    result.compgroups[COMPTYPE_SLAYER] = compgroup_init(1, sizeof(CSlayer));
-    result.compgroups[COMPTYPE_SLAYME] = compgroup_init(1, sizeof(CSlayMe));
-    result.compgroups[COMPTYPE_OBSTRUCTION] = compgroup_init(60, sizeof(CObstruction));
-    result.compgroups[COMPTYPE_TILE] = compgroup_init(60, sizeof(CTile));
-    result.compgroups[COMPTYPE_HERDER] = compgroup_init(1, sizeof(CHerder));
-    result.compgroups[COMPTYPE_FLOCK] = compgroup_init(10, sizeof(CFlock));
-    result.compgroups[COMPTYPE_COOLDOWN] = compgroup_init(10, sizeof(CCooldown));
-    result.compgroups[COMPTYPE_TWEEN] = compgroup_init(10, sizeof(CCooldown));
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        result.compgroups[r] = compgroup_init(group_totals[r], group_sizes[r]);
+    }
+    memset(result.tiles, 0, sizeof(result.tiles));
+    result.round = 1;
+    result.nmoved = 0;
+    result.nmoves = 0;
     return result;
 }
 
-Entity type_at(State* state, uint8_t comptype, Coord tile_x, Coord tile_y) {
-    CompGroup* groups[] = {
-        &state->components.compgroups[comptype],
-        &state->components.compgroups[COMPTYPE_POSITION],
-    };
-    void* comps[] = {NULL, NULL};
-    while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
-        CPosition* position = (CPosition*)comps[1];
+size_t components_size() {
+    size_t result = 0;
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        result += group_bytes(r);
+    }
+    return result;
+}
+
+Components components_new_in(void* memory) {
+    Components result;
+    uint8_t* next = (uint8_t*)memory;
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        result.compgroups[r] = compgroup_init_in(group_totals[r], group_sizes[r], next);
+        next += group_bytes(r);
+    }
+    memset(result.tiles, 0, sizeof(result.tiles));
+    result.round = 1;
+    result.nmoved = 0;
+    result.nmoves = 0;
+    return result;
+}
+
+void components_free(Components* comps) {
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        compgroup_free(&comps->compgroups[r]);
+    }
+}
 
-        if (tile_x == position->x && tile_y == position->y) {
-            return position->entity;
+int components_copy(Components* dest, const Components* source) {
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        if (compgroup_copy(&dest->compgroups[r], &source->compgroups[r]) != 0) {
+            ERROR("compgroup_copy");
+            return 1;
         }
     }
+    memcpy(dest->tiles, source->tiles, sizeof(dest->tiles));
+    dest->round = source->round;
+    dest->nmoved = source->nmoved;
+    dest->nmoves = source->nmoves;
+    return 0;
+}
 
+int components_copy_some(Components* dest, const Components* source, uint32_t comptypes) {
+    for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
+        if ((comptypes & ((uint32_t)1 << r)) == 0) {
+            compgroup_clear(&dest->compgroups[r]);
+        } else if (compgroup_copy(&dest->compgroups[r], &source->compgroups[r]) != 0) {
+            ERROR("compgroup_copy");
+            return 1;
+        }
+    }
+    memcpy(dest->tiles, source->tiles, sizeof(dest->tiles));
+    dest->round = source->round;
+    dest->nmoved = source->nmoved;
+    dest->nmoves = source->nmoves;
     return 0;
 }
 
+static bool tile_valid(Coord tile_x, Coord tile_y) {
+    return tile_x >= 0 && tile_y >= 0 && tile_x < TILES_ACROSS && tile_y < TILES_DOWN;
+}
+
+Entity type_at(Components* comps, uint8_t comptype, Coord tile_x, Coord tile_y) {
+    if (!tile_valid(tile_x, tile_y)) {
+        return 0;
+    }
+    Entity entity = comps->tiles[tile_y * TILES_ACROSS + tile_x];
+    if (entity == 0 || component_of(&comps->compgroups[comptype], entity) == NULL) {
+        return 0;
+    }
+    return entity;
+}
+
+Bitboard type_bits(Components* comps, uint8_t comptype) {
+    Bitboard result = 0;
+    CompGroup* groups[] = {
+        &comps->compgroups[comptype],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        result |= (Bitboard)1 << (position->y * TILES_ACROSS + position->x);
+    }
+    return result;
+}
+
+Bitboard terrain_bits(Components* comps) {
+    return type_bits(comps, COMPTYPE_TILE);
+}
+
 void components_entity_end(Components* comps, Entity entity) {
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], entity);
+    if (position != NULL) {
+        position_set(comps, position, -1, -1);
+    }
+    if (cooldown_active(comps, entity)) {
+        comps->nmoved -= 1;
+    }
     compgroups_entity_end(comps->compgroups, COMPTYPE_COUNT, entity);
 }
 
@@ -47,18 +162,38 @@ void components_clear(Components* comps) {
     for (size_t r = 0; r < COMPTYPE_COUNT; r += 1) {
         compgroup_clear(&comps->compgroups[r]);
     }
+    memset(comps->tiles, 0, sizeof(comps->tiles));
+    comps->round = 1;
+    comps->nmoved = 0;
+    comps->nmoves = 0;
 }
 
 CPosition* position_init(Components* components, Entity entity, Coord x, Coord y) {
     CompGroup* group = &components->compgroups[COMPTYPE_POSITION];
     CPosition* result = (CPosition*)component_init(group, entity);
     if (result != NULL) {
-        result->x = x;
-        result->y = y;
+        result->x = -1;
+        result->y = -1;
+        position_set(components, result, x, y);
     }
     return result;
 }
 
+void position_set(Components* comps, CPosition* position, Coord x, Coord y) {
+    /* Another entity may have moved onto the old tile already. */
+    if (tile_valid(position->x, position->y)) {
+        Entity* old = &comps->tiles[position->y * TILES_ACROSS + position->x];
+        if (*old == position->entity) {
+            *old = 0;
+        }
+    }
+    if (tile_valid(x, y)) {
+        comps->tiles[y * TILES_ACROSS + x] = position->entity;
+    }
+    position->x = x;
+    position->y = y;
+}
+
 CAvatar* avatar_init(Components* components, Entity entity, IconID icon_id, float_t x, float_t y) {
     CompGroup* group = &components->compgroups[COMPTYPE_AVATAR];
     CAvatar* result = (CAvatar*)component_init(group, entity);
@@ -76,7 +211,11 @@ void* empty_init(Components* components, uint8_t comptype, Entity entity) {
 }
 
 CSelectable* selectable_init(Components* components, Entity entity) {
-    return (CSelectable*)empty_init(components, COMPTYPE_SELECTABLE, entity);
+    CSelectable* result = (CSelectable*)empty_init(components, COMPTYPE_SELECTABLE, entity);
+    if (result != NULL) {
+        result->moved = 0;
+    }
+    return result;
 }
 
 CMount* mount_init(Components* components, Entity entity) {
@@ -124,8 +263,45 @@ CFlock* flock_init(Components* components, Entity entity) {
     return (CFlock*)empty_init(components, COMPTYPE_FLOCK, entity);
 }
 
-CCooldown* cooldown_init(Components* components, Entity entity) {
-    return (CCooldown*)empty_init(components, COMPTYPE_COOLDOWN, entity);
+bool cooldown_active(Components* comps, Entity entity) {
+    CSelectable* selectable = component_of(&comps->compgroups[COMPTYPE_SELECTABLE], entity);
+    return selectable != NULL && selectable->moved == comps->round;
+}
+
+void cooldown_start(Components* comps, Entity entity) {
+    CSelectable* selectable = component_of(&comps->compgroups[COMPTYPE_SELECTABLE], entity);
+    if (selectable == NULL || selectable->moved == comps->round) {
+        return;
+    }
+    selectable->moved = comps->round;
+    comps->nmoved += 1;
+
+    /* Clear cooldowns when last piece moves. */
+    if (comps->nmoved >= comps->compgroups[COMPTYPE_SELECTABLE].alive) {
+        cooldown_reset(comps);
+    }
+}
+
+void cooldown_reset(Components* comps) {
+    comps->round += 1;
+    comps->nmoved = 0;
+}
+
+Bitboard cooldown_bits(Components* comps) {
+    Bitboard result = 0;
+    CompGroup* groups[] = {
+        &comps->compgroups[COMPTYPE_SELECTABLE],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CSelectable* selectable = (CSelectable*)iter[0];
+        CPosition* position = (CPosition*)iter[1];
+        if (selectable->moved == comps->round) {
+            result |= (Bitboard)1 << (position->y * TILES_ACROSS + position->x);
+        }
+    }
+    return result;
 }
 
 CTween* tween_init(Components* components, Entity entity) {
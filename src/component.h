@@ -5,10 +5,52 @@
 Components components_new();
 
 /*
- Returns: The entity that has a position component that matches the given tile_x and tile_y, or
-          0 if there is no such entity.
+ Returns: The number of bytes of memory that components_new_in() needs.
  */
-Entity type_at(State* state, uint8_t comptype, Coord tile_x, Coord tile_y);
+size_t components_size();
+
+/*
+ Same as components_new() but keeps every group in memory, which must be at least
+ components_size() bytes, aligned for uint64_t and outlive the components. Don't call
+ components_free() on the result.
+ */
+Components components_new_in(void* memory);
+
+/*
+ Deallocates the memory of every component group.
+ */
+void components_free(Components* comps);
+
+/*
+ Replaces the contents of dest with a copy of source. Both must have been created with
+ components_new().
+ Returns: 0 if successful
+ */
+int components_copy(Components* dest, const Components* source);
+
+/*
+ Like components_copy() but only copies the groups whose bits are set in comptypes, leaving the
+ others empty. The tile index is copied whole.
+ Returns: 0 if successful
+ */
+int components_copy_some(Components* dest, const Components* source, uint32_t comptypes);
+
+/*
+ Looks the tile up in the tile index, so it takes the same time however many pieces there are.
+ Returns: The entity that has a position component that matches the given tile_x and tile_y and a
+          component of comptype, or 0 if there is no such entity.
+ */
+Entity type_at(Components* comps, uint8_t comptype, Coord tile_x, Coord tile_y);
+
+/*
+ Returns: The tiles of the entities that have both comptype and a position.
+ */
+Bitboard type_bits(Components* comps, uint8_t comptype);
+
+/*
+ Returns: The tiles taken up by terrain.
+ */
+Bitboard terrain_bits(Components* comps);
 
 void components_entity_end(Components* comps, Entity entity);
 
@@ -19,6 +61,12 @@ void components_clear(Components* comps);
  */
 CPosition* position_init(Components* components, Entity entity, Coord x, Coord y);
 
+/*
+ Moves a position and keeps the tile index that type_at() uses up to date. Positions should only be
+ changed through this. Coordinates off the board take the entity out of the index.
+ */
+void position_set(Components* comps, CPosition* position, Coord x, Coord y);
+
 /*
  Returns: A pointer to the newly initialized component or NULL if out of memory.
  */
@@ -80,9 +128,26 @@ CHerder* herder_init(Components* components, Entity entity);
 CFlock* flock_init(Components* components, Entity entity);
 
 /*
- Returns: A pointer to the newly initialized component or NULL if out of memory.
+ A piece that has moved has to wait until every other selectable piece has moved too. Each piece
+ keeps the round it last moved in, so none of these has to add or remove components.
+ Returns: true if the entity is a selectable piece that has moved this round.
+ */
+bool cooldown_active(Components* comps, Entity entity);
+
+/*
+ Marks a selectable entity as moved this round. Starts a new round once every piece has moved.
+ */
+void cooldown_start(Components* comps, Entity entity);
+
+/*
+ Starts a new round, which takes every piece off cooldown.
+ */
+void cooldown_reset(Components* comps);
+
+/*
+ Returns: The tiles of the pieces that are on cooldown.
  */
-CCooldown* cooldown_init(Components* components, Entity entity);
+Bitboard cooldown_bits(Components* comps);
 
 /*
  Returns: A pointer to the newly initialized component or NULL if out of memory.
@@ -9,6 +9,7 @@
 #define TILES_DOWN 6
 #define TILE_RIGHT (TILES_ACROSS - 1)
 #define TILE_BOTTOM (TILES_DOWN - 1)
+#define TILE_COUNT (TILES_ACROSS * TILES_DOWN)
 
 #define VIEW_WIDTH (TILE_SIZE * TILES_ACROSS)
 #define VIEW_HEIGHT (TILE_SIZE * TILES_DOWN)
@@ -26,7 +27,9 @@
 #define TEXTURE_INSTRUCTIONS 9
 #define TEXTURE_SUCCESS 10
 #define TEXTURE_FAILURE 11
-#define TEXTURE_COUNT 12
+#define TEXTURE_ATLAS 12 /* All of the images above that are loaded from files. See atlas.c */
+#define TEXTURE_FRAME 13 /* The frame as last drawn, so only what changed has to be drawn again. */
+#define TEXTURE_COUNT 14
 
 #define ICON_WALL 0
 #define ICON_FLOOR_A 1
@@ -43,6 +46,22 @@
 #define ICON_SUCCESS 12
 #define ICON_FAILURE 13
 #define ICON_COUNT 14
+#define TERRAIN_FLOOR ICON_COUNT /* Where a tile shows only the floor. See terrain.c */
+
+/*
+ Layers are drawn in this order. Within one, what's drawn is sorted by texture and color, so two
+ things that overlap and have to go in a certain order need layers of their own.
+ */
+#define LAYER_TERRAIN 0
+#define LAYER_SELECT 1
+#define LAYER_ROUTE 2
+#define LAYER_ROUTE_NEXT 3
+#define LAYER_HINT 4
+#define LAYER_AVATAR 5
+#define LAYER_PREVIEW_GONE 6
+#define LAYER_PREVIEW_GHOST 7
+#define LAYER_COOLDOWN 8
+#define LAYER_TEXT 9
 
 /* Putting type definitions here to resolve issues with circular imports. */
 
@@ -50,12 +69,43 @@ typedef int16_t TexID;
 typedef uint8_t IconID;
 typedef int16_t Coord;
 typedef uint8_t LevelID;
+typedef uint8_t Layer;
 
 typedef struct {
     TexID texture_id;
     SDL_Rect source_rect;
 } Icon;
 
+typedef struct {
+    TexID texture_id; /* What icons refer to the image by. */
+    const char* name;
+    const void* mem; /* PNG file contents. */
+    size_t size;
+} AtlasImage;
+
+/* The images that assets are baked from, and checked against when a baked file is loaded. */
+typedef struct {
+    const AtlasImage* sprites; /* Packed into TEXTURE_ATLAS. */
+    uint8_t nsprites;
+    const AtlasImage* captions; /* Each in a texture of its own. */
+    uint8_t ncaptions;
+} AssetsSource;
+
+#define ATLAS_MAX_IMAGES 16
+#define ATLAS_MAX_THREADS 8
+
+/* Images being decoded into surfaces by worker threads. See atlas.c */
+typedef struct {
+    bool started;
+    const AtlasImage* images;
+    uint8_t count;
+    SDL_Surface* surfaces[ATLAS_MAX_IMAGES]; /* NULL where an image failed to decode. */
+    SDL_atomic_t next; /* Index of the next image for a worker to claim. */
+    SDL_atomic_t finished; /* Workers that ran out of images to claim. */
+    SDL_Thread* threads[ATLAS_MAX_THREADS];
+    uint8_t nthreads;
+} AtlasDecode;
+
 typedef enum {
     HoverEmpty,
     HoverValid,
@@ -84,9 +134,8 @@ typedef struct {
 #define COMPTYPE_TILE 10
 #define COMPTYPE_HERDER 11
 #define COMPTYPE_FLOCK 12
-#define COMPTYPE_COOLDOWN 13
-#define COMPTYPE_TWEEN 14
-#define COMPTYPE_COUNT 15
+#define COMPTYPE_TWEEN 13
+#define COMPTYPE_COUNT 14
 
 typedef struct {
     Entity entity;
@@ -108,25 +157,262 @@ typedef struct {
 
 typedef struct {
     Entity entity;
-} CSelectable, CMount, CRider, CMunch, CEdible, CSlayer, CSlayMe, CObstruction, CHerder, CFlock,
-    CCooldown, CTween;
+    uint32_t moved; /* The round it last moved in. See cooldown_active() */
+} CSelectable;
+
+typedef struct {
+    Entity entity;
+} CMount, CRider, CMunch, CEdible, CSlayer, CSlayMe, CObstruction, CHerder, CFlock, CTween;
 
 typedef struct {
     CompGroup compgroups[COMPTYPE_COUNT];
+    Entity tiles[TILE_COUNT]; /* The entity positioned on each tile, or 0. See position_set() */
+    uint32_t round; /* Starts at 1 and counts up each time every selectable piece has moved. */
+    uint32_t nmoved; /* Selectable pieces that have moved this round. */
+    uint32_t nmoves; /* Moves made, so what was worked out from the board can tell it's stale. */
 } Components;
 
+typedef enum {
+    OutcomeInvalid, /* The move isn't allowed and nothing changed. */
+    OutcomeMoved,
+    OutcomeLost,
+    OutcomeWon,
+} Outcome;
+
+typedef struct {
+    Entity subject;
+    Coord x;
+    Coord y;
+} Move;
+
+/* One bit per tile, row by row. */
+typedef uint64_t Bitboard;
+
+#define DOOM_DEPTH 2
+
+/* Cached reachability for spotting levels that can no longer be won. See doom.c */
+typedef struct {
+    bool valid;
+    Bitboard walls;
+    Bitboard regions[TILES_ACROSS * TILES_DOWN]; /* Open tiles connected to each tile. */
+    bool stack_ready;
+    Components stack[DOOM_DEPTH + 1];
+} Doom;
+
+#define TABLEBASE_MAX_PIECES 6
+#define TABLEBASE_MAX_LOADED 8
+
+/* Distance to a win for every placement of a few pieces on one terrain layout. See tablebase.c */
+typedef struct {
+    void* map; /* The whole file, memory mapped. */
+    size_t map_size;
+    const uint8_t* values;
+    uint64_t entries;
+    Bitboard walls;
+    uint8_t npieces;
+    char roster[TABLEBASE_MAX_PIECES]; /* Level character of the kind of piece in each slot. */
+    uint64_t strides[TABLEBASE_MAX_PIECES];
+    uint8_t nopen;
+    uint8_t open_tiles[TILES_ACROSS * TILES_DOWN];
+    uint8_t open_index[TILES_ACROSS * TILES_DOWN]; /* Inverse of open_tiles. 0xFF for terrain. */
+} Tablebase;
+
+#define ENV_MAX_PIECES 10
+#define ENV_ACTIONS (ENV_MAX_PIECES * 4)
+#define ENV_MAX_STEPS 200
+
+/* Layers of an observation. Each is a Bitboard. */
+typedef enum {
+    ENV_PLANE_WALL,
+    ENV_PLANE_DRAGON,
+    ENV_PLANE_KNIGHT,
+    ENV_PLANE_MKNIGHT,
+    ENV_PLANE_HORSE,
+    ENV_PLANE_DOG,
+    ENV_PLANE_SHEEP,
+    ENV_PLANE_COOLDOWN,
+    ENV_PLANES,
+} EnvPlane;
+
+/*
+ Many independent games that are played in lockstep, for running agents in bulk. Per-instance data
+ is kept in parallel arrays indexed by instance. See env.c
+ */
+typedef struct {
+    uint32_t count;
+    void* arena; /* Component memory of every instance, one after the other. */
+    Components* comps;
+    Entity* pieces; /* ENV_MAX_PIECES per instance, in action order. 0 past the last piece. */
+    LevelID* level_ids;
+    uint16_t* steps;
+    float_t* rewards;
+    bool* dones;
+    Bitboard* observations; /* ENV_PLANES per instance. */
+
+    Components* levels; /* Starting position of each level, by LevelID - 1. */
+    LevelID nlevels;
+} VecEnv;
+
+/* Background search for the next move of a shortest solution. See hint.c */
+typedef struct {
+    SDL_Thread* thread;
+    SDL_atomic_t cancel;
+    SDL_atomic_t done;
+    uint32_t deadline;
+    Components snapshot; /* Owned by the worker thread while it runs. */
+    bool found; /* Written by the worker thread before it sets done. */
+    Move found_move;
+    bool pending; /* Requested while a cancelled search was still stopping. */
+    bool visible;
+    Move move;
+    Coord from_x;
+    Coord from_y;
+} Hint;
+
+/* Opponent that moves the dragon with a tree search on background threads. See ai.c */
+typedef struct {
+    bool enabled;
+    uint32_t budget; /* Milliseconds to think about each move. */
+    SDL_Thread* thread;
+    SDL_atomic_t cancel;
+    SDL_atomic_t done;
+    Components snapshot; /* Owned by the worker thread while it runs. */
+    bool found; /* Written by the worker thread before it sets done. */
+    Move found_move;
+} Ai;
+
+#define ROUTE_MAX_MOVES 256
+
+/* Moves that take a piece to a faraway tile, with other pieces moving in between. See route.c */
+typedef struct {
+    Entity subject; /* 0 when there's no route. */
+    Coord target_x;
+    Coord target_y;
+    Move moves[ROUTE_MAX_MOVES];
+    uint16_t nmoves;
+    Bitboard path; /* Tiles that the subject passes through. */
+    uint32_t budget; /* Positions the planner may still search. */
+    Components scratch;
+    Components trial;
+} Route;
+
+#define TEXT_CACHE_SIZE 4
+#define TEXT_SHADOW 2 /* How far down and right the shadow of a caption is. */
+
+/* A caption and its shadow drawn once into a texture of their own. See text.c */
+typedef struct {
+    IconID icon_id;
+    int32_t w; /* What size it's drawn at, not counting the shadow. */
+    int32_t h;
+    SDL_Texture* texture; /* NULL when the slot is free. */
+} TextCache;
+
+#define BATCH_MAX_QUADS 2048
+
+/* Sprites waiting to be drawn with a single SDL_RenderGeometry() call. See batch.c */
+typedef struct {
+    TexID texture_id; /* Of the queued sprites. */
+    uint32_t nquads;
+    float_t texture_w;
+    float_t texture_h;
+    SDL_Color mods[TEXTURE_COUNT]; /* Color and alpha that each texture is drawn with. */
+    SDL_Vertex vertices[BATCH_MAX_QUADS * 4];
+    int indices[BATCH_MAX_QUADS * 6]; /* The same for every frame. */
+} Batch;
+
+#define RENDER_MAX_COMMANDS 1024
+#define RENDER_MAX_COLORS 32
+
+typedef enum {
+    RenderSprite, /* Goes through the batch. */
+    RenderFill,
+    RenderCopy, /* A whole texture, like the terrain or a cached caption. */
+} RenderKind;
+
+typedef struct {
+    RenderKind kind;
+    TexID texture_id; /* Of sprites. */
+    SDL_Texture* texture; /* Of copies. */
+    SDL_Color color; /* Of sprites and fills. */
+    SDL_Rect source_rect; /* Of sprites. */
+    SDL_Rect dest_rect;
+    bool whole; /* Copies to the whole view instead of dest_rect. */
+} RenderCommand;
+
+typedef struct {
+    uint32_t key; /* Layer, then texture, then color. */
+    uint32_t index; /* Of the command. */
+} RenderKey;
+
+/* What drawing a frame took, to keep an eye on. See render.c */
+typedef struct {
+    uint32_t commands;
+    uint32_t draw_calls;
+    uint32_t texture_changes;
+    uint32_t color_changes;
+} RenderStats;
+
+/* What the systems draw in a frame, queued up to be sorted. See render.c */
+typedef struct {
+    bool queueing; /* Between render_begin() and render_submit(). */
+    Layer layer; /* Of commands queued from now on. */
+    SDL_Color color; /* Of fills queued from now on. See draw_set_color() */
+    SDL_Texture* drawn; /* Texture of the last draw call, for counting changes. */
+    RenderStats stats; /* Of the frame being drawn. */
+    RenderStats last; /* Of the last frame drawn. */
+    uint32_t ncommands;
+    uint16_t ncolors;
+    SDL_Color colors[RENDER_MAX_COLORS]; /* Fill colors in the order they were first used. */
+    RenderCommand commands[RENDER_MAX_COMMANDS];
+    RenderKey keys[RENDER_MAX_COMMANDS];
+    RenderKey scratch[RENDER_MAX_COMMANDS]; /* For sorting the keys. */
+} RenderQueue;
+
+/* What the hovered move would do, worked out on a copy of the pieces. See preview.c */
+typedef struct {
+    Entity subject; /* 0 when there's nothing to show. */
+    Coord x;
+    Coord y;
+    uint32_t nmoves; /* The board's count of moves when this was worked out. */
+    Outcome outcome;
+    Bitboard tiles; /* Where the preview draws anything. */
+    Components view;
+} Preview;
+
 typedef struct {
     Selection selection;
     Components components;
+    Hint hint;
+    Ai ai;
+    Route route;
+    Preview preview;
+    Doom doom;
+    Tablebase tablebases[TABLEBASE_MAX_LOADED];
+    uint8_t ntablebases;
     
     SDL_Window* window;
     SDL_Renderer* renderer;
     SDL_Texture* textures[TEXTURE_COUNT];
-    bool needs_redraw;
+    Batch batch;
+    RenderQueue render;
+    TextCache text_cache[TEXT_CACHE_SIZE];
+    SDL_Rect atlas_rects[TEXTURE_COUNT]; /* Where each image is in TEXTURE_ATLAS, or w of 0. */
+    AtlasDecode captions; /* Loaded after the first frame. See text_poll() */
+    const AssetsSource* assets; /* What the textures were loaded from. See assets_reset() */
+    bool needs_redraw; /* The whole view has to be drawn again. */
+    bool damaged; /* Only the damage rect has to be drawn again. See draw_damage() */
+    SDL_Rect damage;
+    bool animating; /* Some avatar hasn't caught up with its position yet. See tween.c */
+    bool vsync; /* Presenting waits for the display, which paces the frames. */
+    Bitboard terrain_dirty; /* Tiles of TEXTURE_TERRAIN to draw again. See terrain.c */
+    IconID terrain_icons[TILE_COUNT]; /* What each tile of TEXTURE_TERRAIN was drawn with. */
+    uint64_t frame_counter; /* SDL_GetPerformanceCounter() when the last frame was drawn. */
     
     Icon icons[ICON_COUNT];
 
     LevelID level_id;
+    char* level_pack; /* Levels to play instead of the built-in ones, or NULL. */
+    LevelID level_count;
 
     bool exiting;
     bool game_over;
@@ -16,13 +16,16 @@ static void cooldown_draw_one(State* state, CPosition* position) {
 
 void cooldown_draw(State* state) {
     CompGroup* groups[] = {
-        &state->components.compgroups[COMPTYPE_COOLDOWN],
+        &state->components.compgroups[COMPTYPE_SELECTABLE],
         &state->components.compgroups[COMPTYPE_POSITION],
     };
     void* comps[] = {NULL, NULL};
     while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
+        CSelectable* selectable = (CSelectable*)comps[0];
         CPosition* position = (CPosition*)comps[1];
 
-        cooldown_draw_one(state, position);
+        if (selectable->moved == state->components.round) {
+            cooldown_draw_one(state, position);
+        }
     }
 }
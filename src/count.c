@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "board.h"
+#include "interact.h"
+#include "solve.h"
+#include "count.h"
+
+#define COUNT_DEFAULT_MAX_NODES 2000000
+
+/*
+ Counts are memoized by position and remaining depth. Different move orders that reach the same
+ position share one entry, which is what keeps the count from exploding with the permutations of
+ independent moves.
+ */
+typedef struct {
+    BoardKey key;
+    uint8_t remaining; /* 0 marks an empty entry since depth 0 is never stored. */
+    uint64_t count;
+} CountEntry;
+
+typedef struct {
+    Solver solver;
+    Components* stack; /* One position per ply of the search. */
+    CountEntry* entries;
+    uint32_t nentries;
+    uint32_t mask;
+    uint32_t max_entries;
+} Counter;
+
+static uint64_t saturating_add(uint64_t a, uint64_t b) {
+    if (a > UINT64_MAX - b) {
+        return UINT64_MAX;
+    }
+    return a + b;
+}
+
+static uint32_t entry_slot(Counter* counter, const BoardKey* key, uint8_t remaining) {
+    uint32_t slot = (solver_key_hash(key) ^ (remaining * 0x9E3779B9u)) & counter->mask;
+    while (true) {
+        CountEntry* entry = &counter->entries[slot];
+        if (entry->remaining == 0) {
+            return slot;
+        }
+        if (entry->remaining == remaining && memcmp(&entry->key, key, sizeof(BoardKey)) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & counter->mask;
+    }
+}
+
+static int counter_grow(Counter* counter) {
+    uint32_t mask = counter->mask * 2 + 1;
+    CountEntry* entries = calloc(mask + 1, sizeof(CountEntry));
+    if (entries == NULL) {
+        return 1;
+    }
+
+    CountEntry* old = counter->entries;
+    uint32_t old_size = counter->mask + 1;
+    counter->entries = entries;
+    counter->mask = mask;
+    for (uint32_t r = 0; r < old_size; r += 1) {
+        if (old[r].remaining != 0) {
+            counter->entries[entry_slot(counter, &old[r].key, old[r].remaining)] = old[r];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static void counter_store(Counter* counter, const BoardKey* key, uint8_t remaining, uint64_t n) {
+    if (counter->nentries >= counter->max_entries) {
+        return; /* Still correct without the entry, just slower. */
+    }
+    if (counter->nentries * 2 >= counter->mask && counter_grow(counter) != 0) {
+        counter->max_entries = counter->nentries;
+        return;
+    }
+
+    CountEntry* entry = &counter->entries[entry_slot(counter, key, remaining)];
+    if (entry->remaining == 0) {
+        counter->nentries += 1;
+    }
+    entry->key = *key;
+    entry->remaining = remaining;
+    entry->count = n;
+}
+
+/*
+ Returns: The number of move sequences of at most remaining moves that win from stack[ply].
+ */
+static uint64_t count_wins(Counter* counter, uint8_t ply, uint8_t remaining) {
+    if (remaining == 0) {
+        return 0;
+    }
+
+    Components* comps = &counter->stack[ply];
+    Components* next = &counter->stack[ply + 1];
+    uint8_t transform;
+    BoardKey actual = solver_key(&counter->solver, comps);
+    BoardKey key = solver_canonical(&counter->solver, &actual, &transform);
+
+    CountEntry* entry = &counter->entries[entry_slot(counter, &key, remaining)];
+    if (entry->remaining != 0) {
+        return entry->count;
+    }
+
+    uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+    uint8_t nmoves = solver_moves(&counter->solver, comps, moves);
+
+    uint64_t total = 0;
+    for (uint8_t r = 0; r < nmoves; r += 1) {
+        if (components_copy(next, comps) != 0) {
+            break;
+        }
+        Move move = solver_move(&counter->solver, next, moves[r]);
+        Outcome outcome = components_command_move(next, move.subject, move.x, move.y);
+        if (outcome == OutcomeWon) {
+            total = saturating_add(total, 1);
+        } else if (outcome == OutcomeMoved) {
+            total = saturating_add(total, count_wins(counter, ply + 1, remaining - 1));
+        }
+    }
+
+    counter_store(counter, &key, remaining, total);
+    return total;
+}
+
+int count_solutions(Components* comps, uint8_t depth, uint32_t max_entries, uint64_t* result) {
+    *result = 0;
+    if (depth == 0) {
+        return 0;
+    }
+
+    Counter counter;
+    memset(&counter, 0, sizeof(counter));
+    counter.max_entries = max_entries;
+    counter.mask = 1023;
+    counter.entries = calloc(counter.mask + 1, sizeof(CountEntry));
+    counter.stack = calloc(depth + 1, sizeof(Components));
+    if (counter.entries == NULL || counter.stack == NULL) {
+        ERROR("Out of memory.");
+        free(counter.entries);
+        free(counter.stack);
+        return 1;
+    }
+
+    int status = solver_init(&counter.solver, comps);
+    for (uint16_t r = 0; r <= depth; r += 1) {
+        counter.stack[r] = components_new();
+    }
+    if (status == 0) {
+        status = components_copy(&counter.stack[0], comps);
+    }
+    if (status == 0) {
+        *result = count_wins(&counter, 0, depth);
+    }
+
+    for (uint16_t r = 0; r <= depth; r += 1) {
+        components_free(&counter.stack[r]);
+    }
+    solver_end(&counter.solver);
+    free(counter.stack);
+    free(counter.entries);
+    return status;
+}
+
+static void count_level(const char* name, LevelID level_id, Components* comps, uint8_t depth) {
+    SolveLimits limits = {
+        .max_nodes = COUNT_DEFAULT_MAX_NODES,
+        .max_depth = 0,
+        .deadline = 0,
+        .cancel = NULL,
+    };
+    SolveResult* result = malloc(sizeof(SolveResult));
+    if (result == NULL) {
+        ERROR("Out of memory.");
+        return;
+    }
+
+    if (solve(comps, &limits, result) != 0 || !result->solved) {
+        printf("%s level %d: %s\n", name, level_id,
+            result->exhausted ? "unsolvable" : "no solution found within search limits");
+        free(result);
+        return;
+    }
+
+    uint8_t shortest = (uint8_t)result->length;
+    if (depth < shortest) {
+        depth = shortest;
+    }
+    free(result);
+
+    uint64_t nshortest = 0;
+    uint64_t nwithin = 0;
+    if (count_solutions(comps, shortest, COUNT_DEFAULT_MAX_NODES, &nshortest) != 0) {
+        printf("%s level %d: counting failed\n", name, level_id);
+        return;
+    }
+    nwithin = nshortest;
+    if (depth > shortest
+            && count_solutions(comps, depth, COUNT_DEFAULT_MAX_NODES, &nwithin) != 0) {
+        printf("%s level %d: counting failed\n", name, level_id);
+        return;
+    }
+
+    printf("%s level %d: %s, shortest %u moves, %llu shortest solutions, "
+        "%llu solutions within %u moves\n",
+        name, level_id, nshortest == 1 ? "unique" : "ambiguous", shortest,
+        (unsigned long long)nshortest, (unsigned long long)nwithin, depth);
+}
+
+int count_main(int argc, char* argv[]) {
+    if (argc < 2) {
+        ERROR("Usage: count DEPTH FILE...");
+        return 1;
+    }
+    unsigned long depth = strtoul(argv[0], NULL, 10);
+    if (depth > SOLVE_MAX_LENGTH) {
+        depth = SOLVE_MAX_LENGTH;
+    }
+
+    Components comps = components_new();
+    int status = 0;
+    for (int r = 1; r < argc; r += 1) {
+        char* pack = level_pack_load(argv[r]);
+        if (pack == NULL) {
+            status = 1;
+            continue;
+        }
+
+        const char* text = pack;
+        LevelID level_id = 0;
+        while (*level_skip(text) != '\0' && level_id < UINT8_MAX) {
+            level_id += 1;
+            components_clear(&comps);
+            if (level_parse(&comps, text, &text) != 0) {
+                WARN("%s level %d doesn't parse.", argv[r], level_id);
+                status = 1;
+                break;
+            }
+            count_level(argv[r], level_id, &comps, (uint8_t)depth);
+        }
+        free(pack);
+    }
+
+    components_free(&comps);
+    return status;
+}
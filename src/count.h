@@ -0,0 +1,14 @@
+
+/*
+ Counts the distinct move sequences of at most depth moves that win the level in comps.
+ max_entries: Limit on the number of memoized positions.
+ Returns: 0 if successful
+ */
+int count_solutions(Components* comps, uint8_t depth, uint32_t max_entries, uint64_t* result);
+
+/*
+ Command line tool that reports how many shortest solutions each level in some level packs has.
+ Usage: count DEPTH FILE...
+ Returns: The process exit status.
+ */
+int count_main(int argc, char* argv[]);
@@ -0,0 +1,634 @@
+/* For getpid(). */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <unistd.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "interact.h"
+#include "solve.h"
+#include "disk.h"
+
+/*
+ Breadth-first search that keeps its frontier and visited set in files instead of a hash table, so
+ it's bounded by disk space instead of memory. Duplicates are found late: each layer's successors
+ are collected in memory until the buffer fills, then sorted and written out as a run. Once the
+ layer is done, the runs are merged together with the visited file in one sequential pass that
+ drops duplicates and writes both the next layer and the new visited file.
+
+ States are stored as the first npieces cells of their canonical BoardKey, which keeps a record to
+ a few bytes. There are no parent links; the solution is traced back afterwards by scanning each
+ layer for a position that leads to the next one.
+ */
+
+#define DISK_BUFFER_BYTES (64u << 20)
+#define DISK_MERGE_WAYS 64
+#define DISK_PATH_SIZE 1024
+#define DISK_IO_BUFFER (1u << 20)
+
+typedef struct {
+    Solver solver;
+    const char* dir;
+    long pid; /* With id, keeps file names apart when searches share a directory. */
+    uint32_t id; /* Of the search within this process. */
+    uint8_t size; /* Bytes per record. */
+    uint8_t* buffer;
+    uint8_t* sorted;
+    size_t capacity; /* Records that fit in the buffer. */
+    size_t count;
+    uint32_t nruns;
+} Disk;
+
+typedef struct {
+    FILE* file;
+    char* io;
+    uint8_t record[SOLVE_MAX_PIECES];
+    bool valid;
+} Reader;
+
+static void disk_path(Disk* disk, char* path, const char* kind, uint32_t number) {
+    snprintf(path, DISK_PATH_SIZE, "%s/solve-%ld-%u-%s-%u.bin",
+        disk->dir, disk->pid, disk->id, kind, number);
+}
+
+static FILE* disk_open(const char* path, const char* mode, char** io) {
+    FILE* file = fopen(path, mode);
+    *io = NULL;
+    if (file == NULL) {
+        ERROR("Couldn't open %s.", path);
+        return NULL;
+    }
+    /* Big buffers so that reads and writes stay sequential. */
+    *io = malloc(DISK_IO_BUFFER);
+    if (*io != NULL) {
+        setvbuf(file, *io, _IOFBF, DISK_IO_BUFFER);
+    }
+    return file;
+}
+
+/*
+ Returns: 0 if everything written to the file made it to disk.
+ */
+static int disk_close(FILE* file, char* io) {
+    int status = 0;
+    if (file != NULL && fclose(file) != 0) {
+        status = 1;
+    }
+    free(io);
+    return status;
+}
+
+static bool reader_next(Reader* reader, uint8_t size) {
+    reader->valid = fread(reader->record, size, 1, reader->file) == 1;
+    return reader->valid;
+}
+
+static int reader_open(Reader* reader, const char* path, uint8_t size) {
+    reader->file = disk_open(path, "rb", &reader->io);
+    if (reader->file == NULL) {
+        reader->valid = false;
+        return 1;
+    }
+    reader_next(reader, size);
+    return 0;
+}
+
+static void reader_close(Reader* reader) {
+    disk_close(reader->file, reader->io);
+    reader->file = NULL;
+    reader->io = NULL;
+}
+
+/* Least significant byte first, so each pass keeps the order of the ones before it. */
+static void records_sort(uint8_t* records, uint8_t* scratch, size_t count, uint8_t size) {
+    uint8_t* from = records;
+    uint8_t* to = scratch;
+    for (int32_t b = size - 1; b >= 0; b -= 1) {
+        size_t offsets[256] = {0};
+        for (size_t r = 0; r < count; r += 1) {
+            offsets[from[r * size + b]] += 1;
+        }
+        size_t total = 0;
+        for (uint32_t v = 0; v < 256; v += 1) {
+            size_t n = offsets[v];
+            offsets[v] = total;
+            total += n;
+        }
+        for (size_t r = 0; r < count; r += 1) {
+            uint8_t* record = &from[r * size];
+            memcpy(&to[offsets[record[b]] * size], record, size);
+            offsets[record[b]] += 1;
+        }
+        uint8_t* swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != records) {
+        memcpy(records, from, count * size);
+    }
+}
+
+/* Sorts the buffered records and writes them out without duplicates. */
+static int disk_flush(Disk* disk) {
+    if (disk->count == 0) {
+        return 0;
+    }
+    records_sort(disk->buffer, disk->sorted, disk->count, disk->size);
+
+    char path[DISK_PATH_SIZE];
+    disk_path(disk, path, "run", disk->nruns);
+    char* io;
+    FILE* file = disk_open(path, "wb", &io);
+    if (file == NULL) {
+        disk_close(file, io);
+        return 1;
+    }
+
+    bool written = true;
+    uint8_t* previous = NULL;
+    for (size_t r = 0; r < disk->count && written; r += 1) {
+        uint8_t* record = &disk->buffer[r * disk->size];
+        if (previous == NULL || memcmp(previous, record, disk->size) != 0) {
+            written = fwrite(record, disk->size, 1, file) == 1;
+        }
+        previous = record;
+    }
+    if (disk_close(file, io) != 0) {
+        written = false;
+    }
+    if (!written) {
+        ERROR("Couldn't write %s.", path);
+        return 1;
+    }
+
+    disk->nruns += 1;
+    disk->count = 0;
+    return 0;
+}
+
+static int disk_add(Disk* disk, const BoardKey* key) {
+    if (disk->count >= disk->capacity && disk_flush(disk) != 0) {
+        return 1;
+    }
+    memcpy(&disk->buffer[disk->count * disk->size], key->cells, disk->size);
+    disk->count += 1;
+    return 0;
+}
+
+/*
+ Returns: The index of the reader with the smallest record, or -1 once they're all used up.
+ */
+static int32_t readers_min(Reader* readers, uint32_t n, uint8_t size) {
+    int32_t best = -1;
+    for (uint32_t r = 0; r < n; r += 1) {
+        if (!readers[r].valid) {
+            continue;
+        }
+        if (best < 0 || memcmp(readers[r].record, readers[best].record, size) < 0) {
+            best = r;
+        }
+    }
+    return best;
+}
+
+/*
+ Merges runs first through first + n - 1 into one run numbered dest, dropping duplicates and
+ deleting the inputs.
+ */
+static int disk_merge_runs(Disk* disk, uint32_t first, uint32_t n, uint32_t dest) {
+    char path[DISK_PATH_SIZE];
+    Reader readers[DISK_MERGE_WAYS];
+    memset(readers, 0, sizeof(readers));
+
+    int status = 0;
+    for (uint32_t r = 0; r < n && status == 0; r += 1) {
+        disk_path(disk, path, "run", first + r);
+        status = reader_open(&readers[r], path, disk->size);
+    }
+
+    disk_path(disk, path, "merged", dest);
+    char* io = NULL;
+    FILE* out = status == 0 ? disk_open(path, "wb", &io) : NULL;
+    if (out == NULL) {
+        status = 1;
+    }
+
+    uint8_t last[SOLVE_MAX_PIECES];
+    bool any = false;
+    while (status == 0) {
+        int32_t best = readers_min(readers, n, disk->size);
+        if (best < 0) {
+            break;
+        }
+        if (!any || memcmp(last, readers[best].record, disk->size) != 0) {
+            if (fwrite(readers[best].record, disk->size, 1, out) != 1) {
+                ERROR("Couldn't write %s.", path);
+                status = 1;
+            }
+            memcpy(last, readers[best].record, disk->size);
+            any = true;
+        }
+        reader_next(&readers[best], disk->size);
+    }
+    if (disk_close(out, io) != 0) {
+        status = 1;
+    }
+
+    for (uint32_t r = 0; r < n; r += 1) {
+        reader_close(&readers[r]);
+        disk_path(disk, path, "run", first + r);
+        remove(path);
+    }
+
+    char run_path[DISK_PATH_SIZE];
+    disk_path(disk, path, "merged", dest);
+    disk_path(disk, run_path, "run", dest);
+    if (status == 0 && rename(path, run_path) != 0) {
+        ERROR("Couldn't rename %s.", path);
+        status = 1;
+    }
+    return status;
+}
+
+/* Merges runs in groups until few enough are left to merge in one pass. */
+static int disk_reduce_runs(Disk* disk) {
+    while (disk->nruns > DISK_MERGE_WAYS) {
+        uint32_t merged = 0;
+        for (uint32_t first = 0; first < disk->nruns; first += DISK_MERGE_WAYS) {
+            uint32_t n = disk->nruns - first;
+            if (n > DISK_MERGE_WAYS) {
+                n = DISK_MERGE_WAYS;
+            }
+            if (disk_merge_runs(disk, first, n, merged) != 0) {
+                return 1;
+            }
+            merged += 1;
+        }
+        disk->nruns = merged;
+    }
+    return 0;
+}
+
+/*
+ Merges the runs with the visited file. Writes what wasn't visited yet as layer depth + 1 and the
+ union as the next visited file.
+ Returns: 0 if successful
+ */
+static int disk_next_layer(Disk* disk, uint16_t depth, uint64_t* added) {
+    *added = 0;
+    if (disk_flush(disk) != 0 || disk_reduce_runs(disk) != 0) {
+        return 1;
+    }
+
+    char path[DISK_PATH_SIZE];
+    Reader readers[DISK_MERGE_WAYS];
+    Reader visited;
+    memset(readers, 0, sizeof(readers));
+    memset(&visited, 0, sizeof(visited));
+
+    int status = 0;
+    for (uint32_t r = 0; r < disk->nruns && status == 0; r += 1) {
+        disk_path(disk, path, "run", r);
+        status = reader_open(&readers[r], path, disk->size);
+    }
+    disk_path(disk, path, "visited", depth);
+    if (status == 0) {
+        status = reader_open(&visited, path, disk->size);
+    }
+
+    char* layer_io = NULL;
+    char* visited_io = NULL;
+    disk_path(disk, path, "layer", depth + 1);
+    FILE* layer = status == 0 ? disk_open(path, "wb", &layer_io) : NULL;
+    disk_path(disk, path, "visited", depth + 1);
+    FILE* union_file = status == 0 ? disk_open(path, "wb", &visited_io) : NULL;
+    if (layer == NULL || union_file == NULL) {
+        status = 1;
+    }
+
+    uint8_t last[SOLVE_MAX_PIECES];
+    bool any = false;
+    while (status == 0) {
+        int32_t best = readers_min(readers, disk->nruns, disk->size);
+        if (best < 0) {
+            break;
+        }
+        uint8_t* record = readers[best].record;
+        if (any && memcmp(last, record, disk->size) == 0) {
+            reader_next(&readers[best], disk->size);
+            continue;
+        }
+        memcpy(last, record, disk->size);
+        any = true;
+        reader_next(&readers[best], disk->size);
+
+        /* Both streams are sorted so the visited file only ever moves forward. */
+        int order = -1;
+        while (visited.valid && (order = memcmp(visited.record, last, disk->size)) < 0) {
+            if (fwrite(visited.record, disk->size, 1, union_file) != 1) {
+                status = 1;
+            }
+            reader_next(&visited, disk->size);
+        }
+        if (visited.valid && order == 0) {
+            continue;
+        }
+
+        if (fwrite(last, disk->size, 1, layer) != 1
+                || fwrite(last, disk->size, 1, union_file) != 1) {
+            status = 1;
+        }
+        *added += 1;
+    }
+    while (status == 0 && visited.valid) {
+        if (fwrite(visited.record, disk->size, 1, union_file) != 1) {
+            status = 1;
+        }
+        reader_next(&visited, disk->size);
+    }
+    status |= disk_close(layer, layer_io);
+    status |= disk_close(union_file, visited_io);
+    if (status != 0) {
+        ERROR("Couldn't write the next layer.");
+    }
+    reader_close(&visited);
+    disk_path(disk, path, "visited", depth);
+    remove(path);
+    for (uint32_t r = 0; r < disk->nruns; r += 1) {
+        reader_close(&readers[r]);
+        disk_path(disk, path, "run", r);
+        remove(path);
+    }
+    disk->nruns = 0;
+    return status;
+}
+
+static BoardKey record_key(Disk* disk, const uint8_t* record) {
+    BoardKey key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.cells, record, disk->size);
+    return key;
+}
+
+/*
+ Plays the move code from the position in scratch into next.
+ Returns: The outcome, with the canonical key of the new position in key when it's OutcomeMoved.
+ */
+static Outcome disk_play(Disk* disk, uint8_t code, BoardKey* key) {
+    Solver* solver = &disk->solver;
+    if (components_copy(&solver->next, &solver->scratch) != 0) {
+        ERROR("components_copy");
+        return OutcomeInvalid;
+    }
+    Move move = solver_move(solver, &solver->next, code);
+    Outcome outcome = components_command_move(&solver->next, move.subject, move.x, move.y);
+    if (outcome == OutcomeMoved) {
+        uint8_t transform;
+        BoardKey actual = solver_key(solver, &solver->next);
+        *key = solver_canonical(solver, &actual, &transform);
+    }
+    return outcome;
+}
+
+/*
+ Scans layer depth for a position with a move that leads to target.
+ Returns: 0 if one was found, which then replaces target.
+ */
+static int disk_trace_back(Disk* disk, uint16_t depth, BoardKey* target) {
+    char path[DISK_PATH_SIZE];
+    Reader reader;
+    disk_path(disk, path, "layer", depth);
+    if (reader_open(&reader, path, disk->size) != 0) {
+        return 1;
+    }
+
+    int status = 1;
+    for (; reader.valid && status != 0; reader_next(&reader, disk->size)) {
+        BoardKey key = record_key(disk, reader.record);
+        if (solver_load(&disk->solver, &disk->solver.scratch, &key) != 0) {
+            break;
+        }
+        uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+        uint8_t nmoves = solver_moves(&disk->solver, &disk->solver.scratch, moves);
+        for (uint8_t r = 0; r < nmoves; r += 1) {
+            BoardKey next;
+            if (disk_play(disk, moves[r], &next) == OutcomeMoved
+                    && memcmp(&next, target, sizeof(BoardKey)) == 0) {
+                *target = key;
+                status = 0;
+                break;
+            }
+        }
+    }
+    reader_close(&reader);
+    return status;
+}
+
+/*
+ Replays the chain of canonical positions from the actual start to work out the real moves.
+ */
+static int disk_solution_init(
+        Disk* disk, const BoardKey* chain, uint16_t length, SolveResult* result) {
+    Solver* solver = &disk->solver;
+    BoardKey actual = solver_key(solver, &solver->initial);
+
+    for (uint16_t step = 0; step < length; step += 1) {
+        if (solver_load(solver, &solver->scratch, &actual) != 0) {
+            return 1;
+        }
+        uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+        uint8_t nmoves = solver_moves(solver, &solver->scratch, moves);
+
+        bool found = false;
+        for (uint8_t r = 0; r < nmoves && !found; r += 1) {
+            BoardKey next;
+            Outcome outcome = disk_play(disk, moves[r], &next);
+            bool last = step + 1 == length;
+            if ((last && outcome == OutcomeWon) || (!last && outcome == OutcomeMoved
+                    && memcmp(&next, &chain[step + 1], sizeof(BoardKey)) == 0)) {
+                result->moves[step] = solver_move(solver, &solver->scratch, moves[r]);
+                actual = solver_key(solver, &solver->next);
+                found = true;
+            }
+        }
+        if (!found) {
+            ERROR("Lost track of the solution.");
+            return 1;
+        }
+    }
+    result->length = length;
+    return 0;
+}
+
+static void disk_cleanup(Disk* disk, uint16_t depth) {
+    char path[DISK_PATH_SIZE];
+    for (uint32_t r = 0; r < disk->nruns; r += 1) {
+        disk_path(disk, path, "run", r);
+        remove(path);
+    }
+    for (uint16_t r = 0; r <= depth + 1; r += 1) {
+        disk_path(disk, path, "layer", r);
+        remove(path);
+        disk_path(disk, path, "visited", r);
+        remove(path);
+    }
+}
+
+/* Writes the canonical start position as layer 0 and the first visited file. */
+static int disk_start(Disk* disk, BoardKey* start) {
+    char path[DISK_PATH_SIZE];
+    const char* kinds[] = {"layer", "visited"};
+    for (uint8_t r = 0; r < 2; r += 1) {
+        disk_path(disk, path, kinds[r], 0);
+        FILE* file = fopen(path, "wb");
+        if (file == NULL) {
+            ERROR("Couldn't open %s.", path);
+            return 1;
+        }
+        bool written = fwrite(start->cells, disk->size, 1, file) == 1;
+        if (fclose(file) != 0 || !written) {
+            ERROR("Couldn't write %s.", path);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ Expands every position in layer depth, adding the new ones to the runs.
+ Returns: 0 if successful. Sets won to the position with a winning move if there is one.
+ */
+static int disk_expand(
+        Disk* disk, uint16_t depth, const SolveLimits* limits, SolveResult* result,
+        uint64_t* legal_total, bool* won, BoardKey* winner, bool* stopped) {
+    char path[DISK_PATH_SIZE];
+    Reader reader;
+    disk_path(disk, path, "layer", depth);
+    if (reader_open(&reader, path, disk->size) != 0) {
+        return 1;
+    }
+
+    int status = 0;
+    for (; reader.valid && status == 0 && !*won; reader_next(&reader, disk->size)) {
+        if ((result->nodes & 0xFF) == 0 && solve_out_of_time(limits)) {
+            *stopped = true;
+            break;
+        }
+        if (limits->max_nodes != 0 && result->nodes >= limits->max_nodes) {
+            *stopped = true;
+            break;
+        }
+
+        BoardKey key = record_key(disk, reader.record);
+        if (solver_load(&disk->solver, &disk->solver.scratch, &key) != 0) {
+            status = 1;
+            break;
+        }
+        uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+        uint8_t nmoves = solver_moves(&disk->solver, &disk->solver.scratch, moves);
+        *legal_total += nmoves;
+        result->nodes += 1;
+
+        for (uint8_t r = 0; r < nmoves; r += 1) {
+            BoardKey next;
+            Outcome outcome = disk_play(disk, moves[r], &next);
+            if (outcome == OutcomeWon) {
+                *won = true;
+                *winner = key;
+                break;
+            }
+            if (outcome == OutcomeMoved && disk_add(disk, &next) != 0) {
+                status = 1;
+                break;
+            }
+        }
+    }
+    reader_close(&reader);
+    return status;
+}
+
+int disk_solve(Components* comps, const char* dir, const SolveLimits* limits, SolveResult* result) {
+    static SDL_atomic_t next_id;
+    memset(result, 0, sizeof(SolveResult));
+
+    uint16_t max_depth = limits->max_depth;
+    if (max_depth == 0 || max_depth > SOLVE_MAX_LENGTH) {
+        max_depth = SOLVE_MAX_LENGTH;
+    }
+
+    Disk disk;
+    memset(&disk, 0, sizeof(disk));
+    disk.dir = dir;
+    disk.pid = (long)getpid();
+    disk.id = (uint32_t)SDL_AtomicAdd(&next_id, 1);
+    if (solver_init(&disk.solver, comps) != 0) {
+        solver_end(&disk.solver);
+        return 1;
+    }
+    disk.size = disk.solver.npieces > 0 ? disk.solver.npieces : 1;
+    disk.capacity = DISK_BUFFER_BYTES / disk.size;
+    disk.buffer = malloc(disk.capacity * disk.size);
+    disk.sorted = malloc(disk.capacity * disk.size);
+    if (disk.buffer == NULL || disk.sorted == NULL) {
+        ERROR("Out of memory.");
+        free(disk.buffer);
+        free(disk.sorted);
+        solver_end(&disk.solver);
+        return 1;
+    }
+
+    uint8_t transform;
+    BoardKey actual = solver_key(&disk.solver, comps);
+    BoardKey start = solver_canonical(&disk.solver, &actual, &transform);
+    int status = disk_start(&disk, &start);
+
+    uint64_t legal_total = 0;
+    uint16_t depth = 0;
+    bool won = false;
+    bool stopped = false;
+    BoardKey winner;
+    while (status == 0) {
+        status = disk_expand(&disk, depth, limits, result, &legal_total, &won, &winner, &stopped);
+        if (status != 0 || won || stopped) {
+            break;
+        }
+        if (depth + 1 >= max_depth) {
+            stopped = true;
+            break;
+        }
+
+        uint64_t added = 0;
+        status = disk_next_layer(&disk, depth, &added);
+        depth += 1;
+        if (added == 0) {
+            break;
+        }
+    }
+
+    if (status == 0 && won) {
+        BoardKey chain[SOLVE_MAX_LENGTH];
+        chain[depth] = winner;
+        for (uint16_t r = depth; r > 0 && status == 0; r -= 1) {
+            chain[r - 1] = chain[r];
+            status = disk_trace_back(&disk, r - 1, &chain[r - 1]);
+        }
+        if (status == 0) {
+            status = disk_solution_init(&disk, chain, depth + 1, result);
+        }
+        result->solved = status == 0;
+    }
+
+    result->exhausted = !result->solved && !stopped && status == 0;
+    if (result->nodes > 0) {
+        result->branching = (float_t)legal_total / (float_t)result->nodes;
+    }
+
+    disk_cleanup(&disk, depth);
+    free(disk.buffer);
+    free(disk.sorted);
+    solver_end(&disk.solver);
+    return status;
+}
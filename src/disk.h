@@ -0,0 +1,8 @@
+
+/*
+ Same search as solve() but with the frontier and visited positions kept in files under dir, for
+ levels with more positions than fit in memory. Needs about two bytes per piece per position of
+ free disk space, and DISK_BUFFER_BYTES twice over of memory.
+ Returns: 0 if the search ran, even if it found no solution.
+ */
+int disk_solve(Components* comps, const char* dir, const SolveLimits* limits, SolveResult* result);
@@ -0,0 +1,209 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "interact.h"
+#include "draw.h"
+#include "tablebase.h"
+#include "doom.h"
+
+#if TILES_ACROSS * TILES_DOWN > 64
+#error "Board is too big for Bitboard."
+#endif
+
+#define BOARD_BITS (TILE_COUNT == 64 ? ~(Bitboard)0 : (((Bitboard)1 << TILE_COUNT) - 1))
+
+static const Coord dir_dx[] = {0, 1, 0, -1};
+static const Coord dir_dy[] = {-1, 0, 1, 0};
+
+static Bitboard column_bits(Coord x) {
+    Bitboard result = 0;
+    for (Coord y = 0; y < TILES_DOWN; y += 1) {
+        result |= (Bitboard)1 << (y * TILES_ACROSS + x);
+    }
+    return result;
+}
+
+/* Grows seed one tile at a time in the four directions until it fills its part of open. */
+static Bitboard flood(Bitboard seed, Bitboard open) {
+    Bitboard not_left = BOARD_BITS & ~column_bits(0);
+    Bitboard not_right = BOARD_BITS & ~column_bits(TILE_RIGHT);
+
+    Bitboard previous = 0;
+    seed &= open;
+    while (seed != previous) {
+        previous = seed;
+        seed |= ((seed << 1) & not_left) | ((seed >> 1) & not_right)
+            | (seed << TILES_ACROSS) | (seed >> TILES_ACROSS);
+        seed &= open;
+    }
+    return seed;
+}
+
+/* Walls never move, so the regions they divide the board into are worked out once per level. */
+static void doom_terrain_init(Doom* doom, Components* comps) {
+    doom->walls = terrain_bits(comps);
+
+    Bitboard open = BOARD_BITS & ~doom->walls;
+    Bitboard done = 0;
+    for (uint8_t r = 0; r < TILE_COUNT; r += 1) {
+        Bitboard bit = (Bitboard)1 << r;
+        if ((done & bit) != 0) {
+            continue;
+        }
+        Bitboard region = flood(bit, open);
+        done |= region | bit;
+        for (uint8_t t = 0; t < TILE_COUNT; t += 1) {
+            if ((region & ((Bitboard)1 << t)) != 0) {
+                doom->regions[t] = region;
+            }
+        }
+        if (region == 0) {
+            doom->regions[r] = 0;
+        }
+    }
+    doom->valid = true;
+}
+
+/* Union of the regions that pieces with the component type can move around in. */
+static Bitboard reach_of(Doom* doom, Components* comps, uint8_t comptype) {
+    Bitboard result = 0;
+    CompGroup* groups[] = {
+        &comps->compgroups[comptype],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        result |= doom->regions[position->y * TILES_ACROSS + position->x];
+    }
+    return result;
+}
+
+/* Every dragon has to be in the region of a slayer, or of a rider that shares it with a mount. */
+static bool win_reachable(Doom* doom, Components* comps) {
+    Bitboard armed = reach_of(doom, comps, COMPTYPE_SLAYER);
+    Bitboard mounts = type_bits(comps, COMPTYPE_MOUNT);
+
+    CompGroup* groups[] = {
+        &comps->compgroups[COMPTYPE_RIDER],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        Bitboard region = doom->regions[position->y * TILES_ACROSS + position->x];
+        if ((region & mounts) != 0) {
+            armed |= region;
+        }
+    }
+
+    Bitboard slaymes = type_bits(comps, COMPTYPE_SLAYME);
+    return slaymes != 0 && (slaymes & ~armed) == 0;
+}
+
+/*
+ Returns: true if every line of play from stack[ply] within depth moves loses or gets stuck.
+ */
+static bool lost_within(Doom* doom, uint8_t ply, uint8_t depth) {
+    Components* comps = &doom->stack[ply];
+    if (!win_reachable(doom, comps)) {
+        return true;
+    }
+    if (depth == 0) {
+        return false;
+    }
+
+    Components* next = &doom->stack[ply + 1];
+    CompGroup* selectables = &comps->compgroups[COMPTYPE_SELECTABLE];
+    for (uint32_t r = 0; r < selectables->alive; r += 1) {
+        Entity subject = ((CSelectable*)selectables->mem)[r].entity;
+        if (cooldown_active(comps, subject)) {
+            continue;
+        }
+        CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], subject);
+        if (position == NULL) {
+            continue;
+        }
+
+        for (uint8_t dir = 0; dir < 4; dir += 1) {
+            Coord x = position->x + dir_dx[dir];
+            Coord y = position->y + dir_dy[dir];
+            if (!components_will_move(comps, subject, x, y)) {
+                continue;
+            }
+            if (components_copy(next, comps) != 0) {
+                return false;
+            }
+
+            Outcome outcome = components_command_move(next, subject, x, y);
+            if (outcome == OutcomeWon) {
+                return false;
+            }
+            if (outcome == OutcomeMoved && !lost_within(doom, ply + 1, depth - 1)) {
+                return false;
+            }
+        }
+    }
+
+    /* Includes having no legal moves at all, which leaves the board stuck forever. */
+    return true;
+}
+
+void doom_reset(Doom* doom) {
+    doom->valid = false;
+}
+
+void doom_end(Doom* doom) {
+    if (doom->stack_ready) {
+        for (uint8_t r = 0; r <= DOOM_DEPTH; r += 1) {
+            components_free(&doom->stack[r]);
+        }
+        doom->stack_ready = false;
+    }
+}
+
+bool doom_lost(Doom* doom, Components* comps) {
+    if (!doom->valid) {
+        doom_terrain_init(doom, comps);
+    }
+
+    /* Cheap check first so that most moves don't need a search. */
+    if (!win_reachable(doom, comps)) {
+        return true;
+    }
+
+    if (!doom->stack_ready) {
+        for (uint8_t r = 0; r <= DOOM_DEPTH; r += 1) {
+            doom->stack[r] = components_new();
+        }
+        doom->stack_ready = true;
+    }
+    if (components_copy(&doom->stack[0], comps) != 0) {
+        ERROR("components_copy");
+        return false;
+    }
+    return lost_within(doom, 0, DOOM_DEPTH);
+}
+
+bool doom_check(State* state) {
+    /* The search moves the dragon too, so it doesn't know that an AI dragon passes when stuck. */
+    if (state->game_over || state->ai.enabled) {
+        return false;
+    }
+    /* A tablebase gives the exact answer when it covers the position. */
+    uint8_t value = tablebases_probe(state, &state->components);
+    if (value == TABLEBASE_NONE) {
+        if (!doom_lost(&state->doom, &state->components)) {
+            return false;
+        }
+    } else if (value != TABLEBASE_LOST) {
+        return false;
+    }
+
+    state->game_over = true;
+    state->won = false;
+    redraw(state);
+    return true;
+}
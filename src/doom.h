@@ -0,0 +1,20 @@
+
+/*
+ Forgets the cached terrain. Call when a level is loaded.
+ */
+void doom_reset(Doom* doom);
+
+void doom_end(Doom* doom);
+
+/*
+ Returns: true if the level in comps can't be won anymore. Only reports positions that are lost for
+          certain: either the pieces that have to meet are walled apart or every line of play within
+          DOOM_DEPTH moves ends with the dragon eating.
+ */
+bool doom_lost(Doom* doom, Components* comps);
+
+/*
+ Ends the game early if the board can no longer be won.
+ Returns: true if the game was ended.
+ */
+bool doom_check(State* state);
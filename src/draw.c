@@ -13,16 +13,60 @@
 #include "cooldown.h"
 #include "tween.h"
 #include "text.h"
+#include "preview.h"
+#include "batch.h"
+#include "render.h"
 
 void redraw(State* state) {
     state->needs_redraw = true;
 }
 
+void draw_damage(State* state, SDL_Rect rect) {
+    if (state->damaged) {
+        SDL_UnionRect(&state->damage, &rect, &state->damage);
+    } else {
+        state->damage = rect;
+        state->damaged = true;
+    }
+}
+
+void draw_damage_tiles(State* state, Bitboard tiles) {
+    for (Coord y = 0; y < TILES_DOWN; y += 1) {
+        for (Coord x = 0; x < TILES_ACROSS; x += 1) {
+            if ((tiles & ((Bitboard)1 << (y * TILES_ACROSS + x))) != 0) {
+                SDL_Rect rect = {x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE};
+                draw_damage(state, rect);
+            }
+        }
+    }
+}
+
+int draw_init(State* state) {
+    uint32_t format = SDL_GetWindowPixelFormat(state->window);
+    if (format == SDL_PIXELFORMAT_UNKNOWN) {
+        WARN("SDL_GetWindowPixelFormat");
+        
+        format = SDL_PIXELFORMAT_RGBA8888;
+    }
+
+    SDL_Texture* frame = SDL_CreateTexture(
+        state->renderer, format, SDL_TEXTUREACCESS_TARGET, VIEW_WIDTH, VIEW_HEIGHT
+    );
+    if (frame == NULL) {
+        /* Still works, only drawing the whole view every time. */
+        WARN("SDL_CreateTexture (frame)");
+        return 0;
+    }
+    state->textures[TEXTURE_FRAME] = frame;
+    redraw(state);
+    return 0;
+}
+
 void draw_text_shadow(State* state, IconID icon_id, SDL_Rect dest_rect) {
     int32_t x = dest_rect.x;
     int32_t y = dest_rect.y;
-    dest_rect.x += 2;
-    dest_rect.y += 2;
+    dest_rect.x += TEXT_SHADOW;
+    dest_rect.y += TEXT_SHADOW;
     
     icon_color_mod(state, icon_id, 0, 0, 0);
     icon_draw(state, icon_id, &dest_rect);
@@ -40,8 +84,78 @@ void draw_loading_done() {
     }
 }
 
+/* Longest step to animate by, so a stall doesn't make everything jump. */
+#define FRAME_MAX_SECONDS 0.1f
+
+/*
+ Returns: Seconds since the last frame that was animating, or 0 if it wasn't so that an animation
+ starts from the beginning however long the game sat idle.
+ */
+static float_t frame_seconds(State* state) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t last = state->frame_counter;
+    state->frame_counter = now;
+    if (!state->animating || last == 0) {
+        return 0;
+    }
+    float_t seconds = (float_t)(now - last) / (float_t)SDL_GetPerformanceFrequency();
+    return seconds < FRAME_MAX_SECONDS ? seconds : FRAME_MAX_SECONDS;
+}
+
+static void layers_draw(State* state) {
+#ifdef DEBUG
+    RenderStats before = *render_stats(state);
+#endif
+    render_begin(state);
+    render_layer(state, LAYER_TERRAIN);
+    terrain_draw(state);
+    render_layer(state, LAYER_SELECT);
+    select_draw(state);
+    render_layer(state, LAYER_AVATAR);
+    avatar_draw(state);
+    render_layer(state, LAYER_PREVIEW_GONE);
+    preview_draw(state);
+    render_layer(state, LAYER_COOLDOWN);
+    cooldown_draw(state);
+    render_layer(state, LAYER_TEXT);
+    text_draw(state);
+    render_submit(state);
+
+#ifdef DEBUG
+    /* Only when it changes, so that frames of an animation don't flood the log. */
+    const RenderStats* stats = render_stats(state);
+    if (memcmp(&before, stats, sizeof(RenderStats)) != 0) {
+        INFO("Frame took %u commands, %u draw calls, %u texture changes and %u color changes.",
+            stats->commands, stats->draw_calls, stats->texture_changes, stats->color_changes);
+    }
+#endif
+}
+
 int draw_now(State* state) {
-    tween_update(state);
+    state->animating = tween_update(state, frame_seconds(state));
+    if (state->animating) {
+        redraw(state);
+    }
+
+    /*
+     Bring the frame buffer up to date by drawing everything again but clipped to what changed.
+     The terrain goes first and covers the whole view so it also clears what's under the clip.
+     */
+    SDL_Texture* frame = state->textures[TEXTURE_FRAME];
+    if (frame != NULL) {
+        if (SDL_SetRenderTarget(state->renderer, frame) != 0) {
+            ERROR("SDL_SetRenderTarget");
+            return 1;
+        }
+        const SDL_Rect* clip = state->needs_redraw ? NULL : &state->damage;
+        if (SDL_RenderSetClipRect(state->renderer, clip) != 0) {
+            WARN("SDL_RenderSetClipRect");
+        }
+        layers_draw(state);
+        if (SDL_RenderSetClipRect(state->renderer, NULL) != 0) {
+            WARN("SDL_RenderSetClipRect");
+        }
+    }
     
     if (SDL_SetRenderTarget(state->renderer, NULL) != 0) {
         ERROR("SDL_SetRenderTarget");
@@ -56,15 +170,16 @@ int draw_now(State* state) {
         WARN("SDL_RenderClear");
     }
 
-    terrain_draw(state);
-    select_draw(state);
-    avatar_draw(state);
-    cooldown_draw(state);
-    text_draw(state);
+    if (frame == NULL) {
+        layers_draw(state);
+    } else if (SDL_RenderCopy(state->renderer, frame, NULL, NULL) != 0) {
+        WARN("SDL_RenderCopy");
+    }
     
     SDL_RenderPresent(state->renderer);
 
     state->needs_redraw = false;
+    state->damaged = false;
     return 0;
 }
 
@@ -140,11 +255,27 @@ void draw_texture(
     if (texture == NULL) {
         return;
     }
+
+    if (source_rect != NULL && dest_rect != NULL) {
+        SDL_Color color = state->batch.mods[texture_id];
+        if (state->render.queueing) {
+            render_sprite(state, texture_id, source_rect, dest_rect, color);
+        } else {
+            batch_add(state, texture_id, source_rect, dest_rect, color);
+        }
+        return;
+    }
+    if (source_rect == NULL && state->render.queueing) {
+        render_copy(state, texture_id, texture, dest_rect);
+        return;
+    }
     
+    batch_flush(state);
     if (SDL_RenderCopy(state->renderer, texture, source_rect, dest_rect) != 0) {
         WARN("SDL_RenderCopy");
         return;
     }
+    render_count_draw(state, texture);
 }
 
 void draw_texture_color_mod(State* state, TexID texture_id, uint8_t r, uint8_t g, uint8_t b) {
@@ -153,17 +284,44 @@ void draw_texture_color_mod(State* state, TexID texture_id, uint8_t r, uint8_t g
         return;
     }
     
+    /* SDL_RenderGeometry() goes by vertex colors and ignores the texture's own modulation. */
+    SDL_Color color = state->batch.mods[texture_id];
+    batch_mod(state, texture_id, (SDL_Color){r, g, b, color.a});
+
     if (SDL_SetTextureColorMod(texture, r, g, b) != 0) {
         WARN("SDL_SetTextureColorMod");
         return;
     }
 }
 
+void draw_texture_alpha_mod(State* state, TexID texture_id, uint8_t alpha) {
+    SDL_Texture* texture = draw_get_texture(state, texture_id);
+    if (texture == NULL) {
+        return;
+    }
+    
+    SDL_Color color = state->batch.mods[texture_id];
+    batch_mod(state, texture_id, (SDL_Color){color.r, color.g, color.b, alpha});
+
+    if (SDL_SetTextureAlphaMod(texture, alpha) != 0) {
+        WARN("SDL_SetTextureAlphaMod");
+        return;
+    }
+}
+
 void draw_set_color(State* state, RGBA color) {
     if (state->renderer == NULL) {
         WARN("Renderer not initialized.");
         return;
     }
+
+    state->render.color = (SDL_Color){color.r, color.g, color.b, color.a};
+    if (state->render.queueing) {
+        return; /* Set when the fills are drawn. */
+    }
+
+    /* Whatever gets drawn in this color has to go over the sprites queued before it. */
+    batch_flush(state);
     
     int8_t r = color.r;
     int8_t g = color.g;
@@ -172,4 +330,18 @@ void draw_set_color(State* state, RGBA color) {
     if (SDL_SetRenderDrawColor(state->renderer, r, g, b, a) != 0) {
         WARN("SDL_SetRenderDrawColor");
     }
+    state->render.stats.color_changes += 1;
+}
+
+void draw_fill_rect(State* state, const SDL_Rect* dest_rect) {
+    if (state->render.queueing) {
+        render_fill(state, dest_rect, state->render.color);
+        return;
+    }
+
+    batch_flush(state);
+    if (SDL_RenderFillRect(state->renderer, dest_rect) != 0) {
+        WARN("SDL_RenderFillRect");
+    }
+    render_count_draw(state, NULL);
 }
@@ -6,8 +6,24 @@ typedef struct {
     uint8_t a;
 } RGBA;
 
+/*
+ Marks the whole view to be drawn again.
+ */
 void redraw(State* state);
 
+/*
+ Marks part of the view to be drawn again, for changes that don't need all of it drawn.
+ */
+void draw_damage(State* state, SDL_Rect rect);
+
+void draw_damage_tiles(State* state, Bitboard tiles);
+
+/*
+ Creates the frame buffer that draws are composed in. Without it the whole view is drawn each time.
+ Returns: 0 if successful
+ */
+int draw_init(State* state);
+
 int draw_now(State* state);
 
 /*
@@ -28,15 +44,26 @@ SDL_Texture* const_png_to_texture(SDL_Renderer* renderer, const void* mem, size_
  */
 int texture_load_const_png(State* state, TexID texture_id, const void* mem, size_t size);
 
+/*
+ Draws part of a texture, or all of it if source_rect is NULL, multiplied by the color and alpha
+ last set for it. While a frame is being drawn it's queued instead. See render.c
+ */
 void draw_texture(
         State* state, TexID texture_id, const SDL_Rect* source_rect, const SDL_Rect* dest_rect);
 
 void draw_texture_color_mod(State* state, TexID texture_id, uint8_t r, uint8_t g, uint8_t b);
 
+void draw_texture_alpha_mod(State* state, TexID texture_id, uint8_t alpha);
+
 void draw_loading_done();
 
+/*
+ Sets the color that draw_fill_rect() fills with.
+ */
 void draw_set_color(State* state, RGBA color);
 
+void draw_fill_rect(State* state, const SDL_Rect* dest_rect);
+
 SDL_Texture* draw_get_texture(State* state, TexID texture_id);
 
 void draw_text_shadow(State* state, IconID icon_id, SDL_Rect dest_rect);
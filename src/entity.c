@@ -19,6 +19,15 @@ CompGroup compgroup_init(uint32_t total, size_t compsize) {
     return result;
 }
 
+CompGroup compgroup_init_in(uint32_t total, size_t compsize, void* memory) {
+    CompGroup result;
+    result.mem = memory;
+    result.alive = 0;
+    result.total = total;
+    result.compsize = compsize;
+    return result;
+}
+
 void compgroup_clear(CompGroup* group) {
     if (group == NULL) {
         ERROR("Component group can't be null.");
@@ -27,6 +36,33 @@ void compgroup_clear(CompGroup* group) {
     group->alive = 0;
 }
 
+void compgroup_free(CompGroup* group) {
+    if (group == NULL) {
+        return;
+    }
+    free(group->mem);
+    group->mem = NULL;
+    group->alive = 0;
+    group->total = 0;
+}
+
+int compgroup_copy(CompGroup* dest, const CompGroup* source) {
+    if (dest == NULL || source == NULL) {
+        ERROR("Component group can't be null.");
+        return 1;
+    }
+    if (dest->compsize != source->compsize) {
+        ERROR("Component sizes don't match.");
+        return 1;
+    }
+    if (dest->total < source->alive) {
+        return 1;
+    }
+    memcpy(dest->mem, source->mem, source->alive * source->compsize);
+    dest->alive = source->alive;
+    return 0;
+}
+
 static AbstractComp* component_at(void* mem, size_t compsize, uint32_t index) {
     return (AbstractComp*)(mem + (index * compsize));
 }
@@ -22,11 +22,29 @@ typedef struct {
  */
 CompGroup compgroup_init(uint32_t total, size_t compsize);
 
+/*
+ Same as compgroup_init() but stores the components in memory, which must hold total * compsize
+ bytes and outlive the group. Don't call compgroup_free() on the result.
+ */
+CompGroup compgroup_init_in(uint32_t total, size_t compsize, void* memory);
+
 /*
  Removes every component in the group.
  */
 void compgroup_clear(CompGroup* group);
 
+/*
+ Deallocates the memory of the group and zeroes it out.
+ */
+void compgroup_free(CompGroup* group);
+
+/*
+ Replaces the contents of dest with a copy of the components in source. Both groups must store the
+ same component type.
+ Returns: 0 if successful or 1 if dest can't hold all of the components.
+ */
+int compgroup_copy(CompGroup* dest, const CompGroup* source);
+
 /*
  Allocates a new component in the component group.
  Returns: A borrowed reference to the new component or NULL if the group is out of memory.
@@ -0,0 +1,217 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "board.h"
+#include "interact.h"
+#include "env.h"
+
+/*
+ Instances don't own any memory of their own. Their components are carved out of one arena and
+ everything else lives in arrays that hold a slot per instance, so stepping a range of instances
+ walks memory in order and never allocates. Resetting copies a level that was built once up front.
+ */
+
+static const Coord dir_dx[] = {0, 1, 0, -1};
+static const Coord dir_dy[] = {-1, 0, 1, 0};
+
+static int env_levels_init(VecEnv* env, const char* pack) {
+    char* text = NULL;
+    if (pack == NULL) {
+        env->nlevels = LEVEL_MAX;
+    } else {
+        text = level_pack_load(pack);
+        env->nlevels = text != NULL ? level_pack_count(text) : 0;
+        if (env->nlevels == 0) {
+            ERROR("No levels in %s.", pack);
+            free(text);
+            return 1;
+        }
+    }
+
+    env->levels = malloc(env->nlevels * sizeof(Components));
+    if (env->levels == NULL) {
+        free(text);
+        return 1;
+    }
+
+    int status = 0;
+    const char* next = text;
+    for (LevelID r = 0; r < env->nlevels; r += 1) {
+        env->levels[r] = components_new();
+        if (status != 0) {
+            continue;
+        }
+        if (text == NULL) {
+            status = level_build(&env->levels[r], r + 1);
+        } else {
+            status = level_parse(&env->levels[r], next, &next);
+        }
+    }
+    free(text);
+    return status;
+}
+
+VecEnv* env_new(uint32_t count, const char* pack) {
+    VecEnv* env = calloc(1, sizeof(VecEnv));
+    if (env == NULL) {
+        ERROR("calloc");
+        return NULL;
+    }
+    env->count = count;
+
+    size_t comps_size = components_size();
+    env->arena = calloc(count, comps_size);
+    env->comps = malloc(count * sizeof(Components));
+    env->pieces = calloc(count * ENV_MAX_PIECES, sizeof(Entity));
+    env->level_ids = calloc(count, sizeof(LevelID));
+    env->steps = calloc(count, sizeof(uint16_t));
+    env->rewards = calloc(count, sizeof(float_t));
+    env->dones = malloc(count * sizeof(bool));
+    env->observations = calloc(count * ENV_PLANES, sizeof(Bitboard));
+    bool allocated = env->arena != NULL && env->comps != NULL && env->pieces != NULL
+        && env->level_ids != NULL && env->steps != NULL && env->rewards != NULL
+        && env->dones != NULL && env->observations != NULL;
+    if (count == 0 || !allocated || env_levels_init(env, pack) != 0) {
+        ERROR("Couldn't create environment.");
+        env_end(env);
+        return NULL;
+    }
+
+    for (uint32_t r = 0; r < count; r += 1) {
+        env->comps[r] = components_new_in((uint8_t*)env->arena + r * comps_size);
+        env->dones[r] = true;
+    }
+    return env;
+}
+
+void env_end(VecEnv* env) {
+    if (env == NULL) {
+        return;
+    }
+    if (env->levels != NULL) {
+        for (LevelID r = 0; r < env->nlevels; r += 1) {
+            components_free(&env->levels[r]);
+        }
+    }
+    free(env->levels);
+    free(env->arena);
+    free(env->comps);
+    free(env->pieces);
+    free(env->level_ids);
+    free(env->steps);
+    free(env->rewards);
+    free(env->dones);
+    free(env->observations);
+    free(env);
+}
+
+static void env_observe(VecEnv* env, uint32_t index) {
+    Components* comps = &env->comps[index];
+    Bitboard* planes = &env->observations[index * ENV_PLANES];
+    planes[ENV_PLANE_WALL] = type_bits(comps, COMPTYPE_TILE);
+    planes[ENV_PLANE_DRAGON] = type_bits(comps, COMPTYPE_SLAYME);
+    planes[ENV_PLANE_KNIGHT] = type_bits(comps, COMPTYPE_RIDER);
+    planes[ENV_PLANE_MKNIGHT] = type_bits(comps, COMPTYPE_SLAYER);
+    planes[ENV_PLANE_HORSE] = type_bits(comps, COMPTYPE_MOUNT);
+    planes[ENV_PLANE_DOG] = type_bits(comps, COMPTYPE_HERDER);
+    planes[ENV_PLANE_SHEEP] = type_bits(comps, COMPTYPE_FLOCK);
+    planes[ENV_PLANE_COOLDOWN] = cooldown_bits(comps);
+}
+
+void env_reset_one(VecEnv* env, uint32_t index, LevelID level_id) {
+    if (index >= env->count) {
+        ERROR("No instance %u.", index);
+        return;
+    }
+    if (level_id < 1 || level_id > env->nlevels) {
+        WARN("Invalid level_id %d.", level_id);
+        level_id = 1;
+    }
+
+    Components* comps = &env->comps[index];
+    if (components_copy(comps, &env->levels[level_id - 1]) != 0) {
+        ERROR("components_copy");
+        env->dones[index] = true;
+        return;
+    }
+
+    /* Pieces are numbered in entity order, same as the solver's move codes. */
+    Entity* pieces = &env->pieces[index * ENV_MAX_PIECES];
+    CompGroup* avatars = &comps->compgroups[COMPTYPE_AVATAR];
+    for (uint32_t r = 0; r < ENV_MAX_PIECES; r += 1) {
+        pieces[r] = r < avatars->alive ? ((CAvatar*)avatars->mem)[r].entity : 0;
+    }
+
+    env->level_ids[index] = level_id;
+    env->steps[index] = 0;
+    env->rewards[index] = 0;
+    env->dones[index] = false;
+    env_observe(env, index);
+}
+
+void env_reset(VecEnv* env, const LevelID* level_ids) {
+    for (uint32_t r = 0; r < env->count; r += 1) {
+        env_reset_one(env, r, level_ids[r]);
+    }
+}
+
+/*
+ Returns: The outcome of the action, which is OutcomeInvalid if it isn't a legal move.
+ */
+static Outcome env_play(Components* comps, const Entity* pieces, uint8_t action) {
+    uint8_t piece = action / 4;
+    uint8_t dir = action % 4;
+    if (piece >= ENV_MAX_PIECES || pieces[piece] == 0) {
+        return OutcomeInvalid;
+    }
+
+    Entity subject = pieces[piece];
+    if (component_of(&comps->compgroups[COMPTYPE_SELECTABLE], subject) == NULL
+            || cooldown_active(comps, subject)) {
+        return OutcomeInvalid;
+    }
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], subject);
+    if (position == NULL) {
+        return OutcomeInvalid;
+    }
+    return components_command_move(
+        comps, subject, position->x + dir_dx[dir], position->y + dir_dy[dir]);
+}
+
+void env_step_range(VecEnv* env, const uint8_t* actions, uint32_t first, uint32_t last) {
+    if (last > env->count) {
+        last = env->count;
+    }
+
+    for (uint32_t r = first; r < last; r += 1) {
+        env->rewards[r] = 0;
+        if (env->dones[r]) {
+            continue;
+        }
+
+        Outcome outcome = env_play(&env->comps[r], &env->pieces[r * ENV_MAX_PIECES], actions[r]);
+        if (outcome == OutcomeInvalid) {
+            env->rewards[r] = ENV_REWARD_INVALID;
+        } else if (outcome == OutcomeWon) {
+            env->rewards[r] = ENV_REWARD_WON;
+            env->dones[r] = true;
+        } else if (outcome == OutcomeLost) {
+            env->rewards[r] = ENV_REWARD_LOST;
+            env->dones[r] = true;
+        }
+
+        env->steps[r] += 1;
+        if (env->steps[r] >= ENV_MAX_STEPS) {
+            env->dones[r] = true;
+        }
+        if (outcome != OutcomeInvalid) {
+            env_observe(env, r);
+        }
+    }
+}
+
+void env_step(VecEnv* env, const uint8_t* actions) {
+    env_step_range(env, actions, 0, env->count);
+}
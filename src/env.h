@@ -0,0 +1,37 @@
+
+/* Rewards for each step. Steps that end in neither get 0. */
+#define ENV_REWARD_WON 1.0f
+#define ENV_REWARD_LOST -1.0f
+#define ENV_REWARD_INVALID -0.1f /* The action isn't a legal move. The board doesn't change. */
+
+/*
+ Creates count instances that play the levels in pack, or the built-in levels if pack is NULL.
+ Every instance starts done until it's reset.
+ Returns: NULL on failure.
+ */
+VecEnv* env_new(uint32_t count, const char* pack);
+
+void env_end(VecEnv* env);
+
+/*
+ Starts instance index over at the beginning of level_id, which counts from 1.
+ */
+void env_reset_one(VecEnv* env, uint32_t index, LevelID level_id);
+
+/*
+ Starts every instance over. level_ids holds one level per instance.
+ */
+void env_reset(VecEnv* env, const LevelID* level_ids);
+
+/*
+ Plays one action in each of the instances from first up to but not including last, then updates
+ their rewards, dones and observations. Actions are piece * 4 + direction, with pieces in the order
+ of env->pieces and directions clockwise from up. Instances that are done are left alone with a
+ reward of 0. Ranges that don't overlap can be stepped from different threads at the same time.
+ */
+void env_step_range(VecEnv* env, const uint8_t* actions, uint32_t first, uint32_t last);
+
+/*
+ Steps every instance. actions holds one action per instance.
+ */
+void env_step(VecEnv* env, const uint8_t* actions);
@@ -7,20 +7,25 @@
 #include "draw.h"
 #include "select.h"
 #include "board.h"
+#include "hint.h"
+#include "ai.h"
+#include "route.h"
+#include "terrain.h"
+#include "text.h"
+#include "assets.h"
 
 void size_changed(State* state, uint32_t width, uint32_t height) {
     /* Letterboxing is done automatically with SDL_RenderSetLogicalSize. */
     redraw(state);
 }
 
+/* Hovering only marks the tiles it changes for drawing. See select.c */
 void mouse_motion(State* state, int32_t x, int32_t y) {
     select_mouse_move(state, x, y);
-    redraw(state);
 }
 
 void mouse_leave(State* state) {
     select_mouse_leave(state);
-    redraw(state);
 }
 
 void mouse_button(State* state, uint8_t button, int32_t x, int32_t y) {
@@ -32,6 +37,15 @@ void key_down(State* state, SDL_Keycode code) {
     if (code == SDLK_r) {
         /* R = restart */
         level_restart(state);
+    } else if (code == SDLK_h) {
+        /* H = hint */
+        hint_request(state);
+    } else if (code == SDLK_a) {
+        /* A = toggle AI dragon */
+        ai_toggle(state);
+    } else if (code == SDLK_SPACE) {
+        /* Space = next move of the planned route */
+        route_step(state);
     } else if (code == SDLK_ESCAPE) {
         /* Esc = quit */
         state->exiting = true;
@@ -44,45 +58,117 @@ void key_down(State* state, SDL_Keycode code) {
     }
 }
 
-int events_pending(State* state) {
+#define EVENTS_WORKER_WAIT_MS 100
+#define EVENTS_FRAME_MS 16 /* About 60fps when there's no vsync to pace the frames. */
+
+static uint32_t wake_type = (uint32_t)-1;
+
+void events_wake() {
+    if (wake_type == (uint32_t)-1) {
+        return;
+    }
     SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_QUIT:
+    memset(&event, 0, sizeof(event));
+    event.type = wake_type;
+    if (SDL_PushEvent(&event) < 0) {
+        WARN("SDL_PushEvent");
+    }
+}
+
+static void event_handle(State* state, SDL_Event* event) {
+    switch (event->type) {
+        case SDL_QUIT:
+            state->exiting = true;
+            return;
+
+        /* on Ubuntu, drag-resize = SizeChanged
+           double click to unmaximize or click unmaximize button = SizeChanged->Restored
+           click on task bar to unminimize = Restored */
+        case SDL_WINDOWEVENT:
+            if (event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                int32_t width = event->window.data1;
+                int32_t height = event->window.data2;
+                size_changed(state, width, height);
+            } else if (event->window.event == SDL_WINDOWEVENT_LEAVE) {
+                mouse_leave(state);
+            } else if (event->window.event == SDL_WINDOWEVENT_EXPOSED) {
+                redraw(state);
+            }
+            return;
+
+        /* The device is gone and every texture with it. */
+        case SDL_RENDER_DEVICE_RESET:
+            if (assets_reset(state) != 0) {
+                ERROR("assets_reset");
                 state->exiting = true;
-                return 0;
-
-            /* on Ubuntu, drag-resize = SizeChanged
-               double click to unmaximize or click unmaximize button = SizeChanged->Restored
-               click on task bar to unminimize = Restored */
-            case SDL_WINDOWEVENT:
-                if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-                    int32_t width = event.window.data1;
-                    int32_t height = event.window.data2;
-                    size_changed(state, width, height);
-                } else if (event.window.event == SDL_WINDOWEVENT_LEAVE) {
-                    mouse_leave(state);
-                }
-                continue;
-
-            case SDL_MOUSEMOTION:
-                /* SDL_GetMouseState doesn't report transformed positions so pass event data. */
-                mouse_motion(state, event.motion.x, event.motion.y);
-                continue;
-
-            case SDL_MOUSEBUTTONDOWN:
-                mouse_button(state, event.button.button, event.button.x, event.button.y);
-                continue;
-
-            case SDL_KEYDOWN:
-                key_down(state, event.key.keysym.sym);
-                continue;
+            }
+            return;
+
+        /* Render targets lose their contents but the textures themselves are still there. */
+        case SDL_RENDER_TARGETS_RESET:
+            text_invalidate(state);
+            terrain_invalidate(state);
+            if (terrain_update(state) != 0) {
+                WARN("terrain_update");
+            }
+            redraw(state);
+            return;
+
+        case SDL_MOUSEMOTION:
+            /* SDL_GetMouseState doesn't report transformed positions so pass event data. */
+            mouse_motion(state, event->motion.x, event->motion.y);
+            return;
+
+        case SDL_MOUSEBUTTONDOWN:
+            mouse_button(state, event->button.button, event->button.x, event->button.y);
+            return;
+
+        case SDL_KEYDOWN:
+            key_down(state, event->key.keysym.sym);
+            return;
+    }
+    /* Wake events only need to get the loop going again. */
+}
+
+int events_pending(State* state) {
+    SDL_Event event;
+    while (!state->exiting && SDL_PollEvent(&event)) {
+        event_handle(state, &event);
+    }
+    return 0;
+}
+
+/*
+ Sleeps until there's an event, or for at most timeout milliseconds unless it's negative. Workers
+ wake the loop up when they finish, but while one is running the wait also times out in case its
+ wake event got lost.
+ */
+static int events_wait(State* state, int32_t timeout) {
+    SDL_Event event;
+    int status;
+    bool working = state->hint.thread != NULL || state->ai.thread != NULL
+        || state->captions.started;
+    if (timeout < 0 && working) {
+        timeout = EVENTS_WORKER_WAIT_MS;
+    }
+    if (timeout >= 0) {
+        status = SDL_WaitEventTimeout(&event, timeout);
+        if (status == 0) {
+            return 0; /* Timed out, or an error that the next wait will run into too. */
+        }
+    } else {
+        status = SDL_WaitEvent(&event);
+        if (status == 0) {
+            ERROR("SDL_WaitEvent");
+            return 1;
         }
     }
+    event_handle(state, &event);
     return 0;
 }
 
 int events_all(State* state) {
+    wake_type = SDL_RegisterEvents(1);
     level_init(state);
     
     if (draw_now(state) != 0) {
@@ -99,17 +185,26 @@ int events_all(State* state) {
             return 0;
         }
 
+        hint_poll(state);
+        text_poll(state);
+        ai_poll(state);
+
         /* Redraw. */
-        /* TODO: Remove finished tweens to avoid unnecessary redrawing and other computations. */
-        if (state->needs_redraw || state->components.compgroups[COMPTYPE_TWEEN].alive > 0) {
+        if (state->needs_redraw || state->damaged || state->animating) {
+            uint32_t start = SDL_GetTicks();
             if (draw_now(state) != 0) {
                 return 1;
             }
 
-            /* TODO: Framerate cap when vsync isn't available. */
-        } else {
-            /* Delay to avoid hogging CPU when there's nothing to draw. */
-            SDL_Delay(10);
+            /* Without vsync nothing else keeps an animation from drawing as fast as it can. */
+            uint32_t elapsed = SDL_GetTicks() - start;
+            if (!state->vsync && state->animating && elapsed < EVENTS_FRAME_MS
+                    && events_wait(state, EVENTS_FRAME_MS - elapsed) != 0) {
+                return 1;
+            }
+        } else if (events_wait(state, -1) != 0) {
+            /* Nothing changes on screen until an event comes in, so sleep until then. */
+            return 1;
         }
     }
 }
@@ -1,2 +1,7 @@
 
 int events_all(State* state);
+
+/*
+ Wakes up the event loop from any thread, for when a worker has something for it.
+ */
+void events_wake();
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <time.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "board.h"
+#include "solve.h"
+#include "generate.h"
+
+#define GENERATE_MIN_LENGTH 8
+#define GENERATE_MAX_NODES 200000
+#define GENERATE_MAX_DEPTH 40
+#define GENERATE_MAX_WALLS 8
+#define GENERATE_MAX_SHEEP 4
+#define GENERATE_MAX_THREADS 64
+
+typedef struct {
+    char text[LEVEL_TEXT_SIZE];
+    uint32_t index; /* Which candidate it was generated from. */
+    uint16_t length;
+    float_t branching;
+} GeneratedLevel;
+
+typedef struct {
+    uint64_t seed;
+    uint32_t wanted;
+    SDL_atomic_t next_index; /* Next candidate to try. */
+    SDL_atomic_t accepted;
+    SDL_mutex* lock;
+    GeneratedLevel* levels;
+    uint32_t count;
+    uint32_t capacity;
+} Generator;
+
+/* splitmix64, so each candidate gets its own reproducible random stream. */
+static uint64_t random_next(uint64_t* state) {
+    *state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = *state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint32_t random_below(uint64_t* state, uint32_t bound) {
+    return (uint32_t)(random_next(state) % bound);
+}
+
+static void random_place(uint64_t* random, char grid[TILES_DOWN][TILES_ACROSS], char c) {
+    while (true) {
+        int32_t x = 1 + random_below(random, TILES_ACROSS - 2);
+        int32_t y = 1 + random_below(random, TILES_DOWN - 2);
+        if (grid[y][x] == LEVEL_CHAR_FLOOR) {
+            grid[y][x] = c;
+            return;
+        }
+    }
+}
+
+/* Lays out a walled arena like the built-in levels and scatters walls and pieces inside it. */
+static void candidate_init(uint64_t seed, uint32_t index, char* text) {
+    uint64_t random = seed ^ ((uint64_t)index * 0xD6E8FEB86659FD93ull);
+
+    char grid[TILES_DOWN][TILES_ACROSS];
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        for (int32_t x = 0; x < TILES_ACROSS; x += 1) {
+            bool corner = (x == 0 || x == TILE_RIGHT) && (y == 0 || y == TILE_BOTTOM);
+            bool edge = x == 0 || y == 0 || x == TILE_RIGHT || y == TILE_BOTTOM;
+            if (corner) {
+                grid[y][x] = LEVEL_CHAR_PYRAMID;
+            } else if (edge) {
+                grid[y][x] = LEVEL_CHAR_WALL;
+            } else {
+                grid[y][x] = LEVEL_CHAR_FLOOR;
+            }
+        }
+    }
+
+    uint32_t walls = random_below(&random, GENERATE_MAX_WALLS + 1);
+    for (uint32_t r = 0; r < walls; r += 1) {
+        char c = random_below(&random, 2) == 0 ? LEVEL_CHAR_WALL : LEVEL_CHAR_PYRAMID;
+        random_place(&random, grid, c);
+    }
+
+    random_place(&random, grid, LEVEL_CHAR_DRAGON);
+    random_place(&random, grid, LEVEL_CHAR_KNIGHT);
+    random_place(&random, grid, LEVEL_CHAR_HORSE);
+    if (random_below(&random, 2) == 0) {
+        random_place(&random, grid, LEVEL_CHAR_DOG);
+    }
+    uint32_t sheep = 1 + random_below(&random, GENERATE_MAX_SHEEP);
+    for (uint32_t r = 0; r < sheep; r += 1) {
+        random_place(&random, grid, LEVEL_CHAR_SHEEP);
+    }
+
+    for (int32_t y = 0; y < TILES_DOWN; y += 1) {
+        memcpy(&text[y * (TILES_ACROSS + 1)], grid[y], TILES_ACROSS);
+        text[y * (TILES_ACROSS + 1) + TILES_ACROSS] = '\n';
+    }
+    text[LEVEL_TEXT_SIZE - 1] = '\0';
+}
+
+static void generator_add(Generator* generator, GeneratedLevel* level) {
+    SDL_LockMutex(generator->lock);
+    if (generator->count >= generator->capacity) {
+        uint32_t capacity = generator->capacity * 2;
+        GeneratedLevel* levels = realloc(generator->levels, capacity * sizeof(GeneratedLevel));
+        if (levels == NULL) {
+            ERROR("Out of memory.");
+            SDL_UnlockMutex(generator->lock);
+            return;
+        }
+        generator->levels = levels;
+        generator->capacity = capacity;
+    }
+    generator->levels[generator->count] = *level;
+    generator->count += 1;
+    SDL_UnlockMutex(generator->lock);
+
+    SDL_AtomicAdd(&generator->accepted, 1);
+}
+
+static int generate_worker(void* data) {
+    Generator* generator = (Generator*)data;
+    Components comps = components_new();
+    SolveResult* result = malloc(sizeof(SolveResult));
+    if (result == NULL) {
+        ERROR("Out of memory.");
+        components_free(&comps);
+        return 1;
+    }
+
+    SolveLimits limits = {
+        .max_nodes = GENERATE_MAX_NODES,
+        .max_depth = GENERATE_MAX_DEPTH,
+        .deadline = 0,
+        .cancel = NULL,
+    };
+
+    while ((uint32_t)SDL_AtomicGet(&generator->accepted) < generator->wanted) {
+        GeneratedLevel level;
+        level.index = (uint32_t)SDL_AtomicAdd(&generator->next_index, 1);
+        candidate_init(generator->seed, level.index, level.text);
+
+        components_clear(&comps);
+        if (level_parse(&comps, level.text, NULL) != 0) {
+            continue;
+        }
+        if (solve(&comps, &limits, result) != 0) {
+            continue;
+        }
+
+        /* Unsolvable, unproven or too easy. */
+        if (!result->solved || result->length < GENERATE_MIN_LENGTH) {
+            continue;
+        }
+
+        level.length = result->length;
+        level.branching = result->branching;
+        generator_add(generator, &level);
+    }
+
+    free(result);
+    components_free(&comps);
+    return 0;
+}
+
+static int compare_index(const void* a, const void* b) {
+    const GeneratedLevel* la = (const GeneratedLevel*)a;
+    const GeneratedLevel* lb = (const GeneratedLevel*)b;
+    return (la->index > lb->index) - (la->index < lb->index);
+}
+
+/* Longest solutions first, then the most choices per move. */
+static int compare_rank(const void* a, const void* b) {
+    const GeneratedLevel* la = (const GeneratedLevel*)a;
+    const GeneratedLevel* lb = (const GeneratedLevel*)b;
+    if (la->length != lb->length) {
+        return (la->length < lb->length) - (la->length > lb->length);
+    }
+    return (la->branching < lb->branching) - (la->branching > lb->branching);
+}
+
+int generate_main(int argc, char* argv[]) {
+    Generator generator;
+    memset(&generator, 0, sizeof(generator));
+    generator.wanted = 10;
+    generator.seed = (uint64_t)time(NULL) / (60 * 60 * 24); /* Same pack all day. */
+    if (argc > 0) {
+        generator.wanted = (uint32_t)strtoul(argv[0], NULL, 10);
+    }
+    if (argc > 1) {
+        generator.seed = strtoull(argv[1], NULL, 10);
+    }
+    if (generator.wanted == 0) {
+        ERROR("Usage: generate [COUNT] [SEED]");
+        return 1;
+    }
+
+    generator.capacity = generator.wanted;
+    generator.levels = malloc(generator.capacity * sizeof(GeneratedLevel));
+    generator.lock = SDL_CreateMutex();
+    if (generator.levels == NULL || generator.lock == NULL) {
+        ERROR("Couldn't create generator.");
+        return 1;
+    }
+
+    int32_t nthreads = SDL_GetCPUCount();
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > GENERATE_MAX_THREADS) {
+        nthreads = GENERATE_MAX_THREADS;
+    }
+
+    uint32_t start = SDL_GetTicks();
+    SDL_Thread* threads[GENERATE_MAX_THREADS];
+    for (int32_t r = 0; r < nthreads; r += 1) {
+        threads[r] = SDL_CreateThread(generate_worker, "generate", &generator);
+        if (threads[r] == NULL) {
+            WARN("SDL_CreateThread");
+        }
+    }
+    for (int32_t r = 0; r < nthreads; r += 1) {
+        if (threads[r] != NULL) {
+            SDL_WaitThread(threads[r], NULL);
+        }
+    }
+
+    /* Every candidate below next_index has been tried, so keeping the earliest ones makes the pack
+       the same no matter how the threads were scheduled. */
+    qsort(generator.levels, generator.count, sizeof(GeneratedLevel), compare_index);
+    if (generator.count > generator.wanted) {
+        generator.count = generator.wanted;
+    }
+    qsort(generator.levels, generator.count, sizeof(GeneratedLevel), compare_rank);
+
+    printf("; Don't Eat My Sheep! level pack, seed %llu\n\n", (unsigned long long)generator.seed);
+    for (uint32_t r = 0; r < generator.count; r += 1) {
+        GeneratedLevel* level = &generator.levels[r];
+        printf("; %u moves, branching %.2f\n", level->length, level->branching);
+        printf("%s\n", level->text);
+    }
+
+    fprintf(stderr, "Generated %u levels from %d candidates with %d threads in %ums.\n",
+        generator.count, SDL_AtomicGet(&generator.next_index), nthreads, SDL_GetTicks() - start);
+
+    SDL_DestroyMutex(generator.lock);
+    free(generator.levels);
+    return 0;
+}
@@ -0,0 +1,7 @@
+
+/*
+ Command line tool that prints a pack of random solvable levels in the level text format.
+ Usage: generate [COUNT] [SEED]
+ Returns: The process exit status.
+ */
+int generate_main(int argc, char* argv[]);
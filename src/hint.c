@@ -0,0 +1,147 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "draw.h"
+#include "solve.h"
+#include "tablebase.h"
+#include "event.h"
+#include "hint.h"
+
+/* Budget for one search. The main thread never waits on it so it only bounds how long the player
+   waits for a hint. */
+#define HINT_BUDGET_MS 1500
+#define HINT_MAX_NODES 2000000
+
+int hint_init(State* state) {
+    Hint* hint = &state->hint;
+    hint->snapshot = components_new();
+    SDL_AtomicSet(&hint->cancel, 0);
+    SDL_AtomicSet(&hint->done, 0);
+    return 0;
+}
+
+void hint_end(State* state) {
+    Hint* hint = &state->hint;
+    if (hint->thread != NULL) {
+        SDL_AtomicSet(&hint->cancel, 1);
+        SDL_WaitThread(hint->thread, NULL);
+        hint->thread = NULL;
+    }
+    components_free(&hint->snapshot);
+}
+
+static int hint_worker(void* data) {
+    Hint* hint = (Hint*)data;
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    SolveLimits limits = {
+        .max_nodes = HINT_MAX_NODES,
+        .max_depth = 0,
+        .deadline = hint->deadline,
+        .cancel = &hint->cancel,
+    };
+    SolveResult* result = malloc(sizeof(SolveResult));
+    if (result != NULL && solve(&hint->snapshot, &limits, result) == 0 && result->solved) {
+        hint->found = true;
+        hint->found_move = result->moves[0];
+    }
+    free(result);
+
+    SDL_AtomicSet(&hint->done, 1);
+    events_wake();
+    return 0;
+}
+
+static void hint_show(State* state, Move move) {
+    Hint* hint = &state->hint;
+    CPosition* position = component_of(
+        &state->components.compgroups[COMPTYPE_POSITION], move.subject);
+    if (position == NULL) {
+        return;
+    }
+    hint->visible = true;
+    hint->move = move;
+    hint->from_x = position->x;
+    hint->from_y = position->y;
+    redraw(state);
+}
+
+static void hint_start(State* state) {
+    Hint* hint = &state->hint;
+    if (components_copy(&hint->snapshot, &state->components) != 0) {
+        ERROR("components_copy");
+        return;
+    }
+
+    hint->found = false;
+    hint->deadline = SDL_GetTicks() + HINT_BUDGET_MS;
+    SDL_AtomicSet(&hint->cancel, 0);
+    SDL_AtomicSet(&hint->done, 0);
+
+    hint->thread = SDL_CreateThread(hint_worker, "hint", hint);
+    if (hint->thread == NULL) {
+        ERROR("SDL_CreateThread");
+    }
+}
+
+void hint_request(State* state) {
+    Hint* hint = &state->hint;
+    /* Solutions assume the player moves the dragon. */
+    if (state->game_over || hint->visible || state->ai.enabled) {
+        return;
+    }
+
+    if (hint->thread != NULL) {
+        if (SDL_AtomicGet(&hint->cancel) != 0) {
+            /* The snapshot is still in use so start over once the old search stops. */
+            hint->pending = true;
+        }
+        return;
+    }
+
+    /* No need to search when a tablebase knows the answer. */
+    Move move;
+    if (tablebases_best_move(state, &hint->snapshot, &move)) {
+        hint_show(state, move);
+        return;
+    }
+    hint_start(state);
+}
+
+void hint_cancel(State* state) {
+    Hint* hint = &state->hint;
+    if (hint->visible) {
+        hint->visible = false;
+        redraw(state);
+    }
+    hint->pending = false;
+    if (hint->thread != NULL) {
+        SDL_AtomicSet(&hint->cancel, 1);
+    }
+}
+
+void hint_poll(State* state) {
+    Hint* hint = &state->hint;
+    if (hint->thread == NULL || SDL_AtomicGet(&hint->done) == 0) {
+        return;
+    }
+
+    /* The worker has already returned, or is about to, so this doesn't block. */
+    SDL_WaitThread(hint->thread, NULL);
+    hint->thread = NULL;
+
+    if (SDL_AtomicGet(&hint->cancel) == 0) {
+        if (hint->found) {
+            hint_show(state, hint->found_move);
+        } else {
+            INFO("No hint found within %dms.", HINT_BUDGET_MS);
+        }
+    }
+
+    if (hint->pending) {
+        hint->pending = false;
+        hint_start(state);
+    }
+}
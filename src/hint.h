@@ -0,0 +1,23 @@
+
+int hint_init(State* state);
+
+/*
+ Cancels any search in progress and waits for it to stop.
+ */
+void hint_end(State* state);
+
+/*
+ Starts searching for a hint in the background unless one is already shown or being searched for.
+ */
+void hint_request(State* state);
+
+/*
+ Hides the hint and stops any search in progress without waiting for it. Call whenever the board
+ changes because the hint would no longer apply.
+ */
+void hint_cancel(State* state);
+
+/*
+ Picks up the result of a finished search. Never blocks on a search that's still running.
+ */
+void hint_poll(State* state);
@@ -30,13 +30,35 @@ Icon icon_tile_new(TexID texture_id, int32_t tile_size, int32_t x, int32_t y) {
     return icon_new(texture_id, source_rect);
 }
 
+/* Points an icon of an image that was packed into the atlas at the same pixels in the atlas. */
+static Icon icon_placed(State* state, Icon icon) {
+    if (icon.texture_id < 0 || icon.texture_id >= TEXTURE_COUNT) {
+        return icon;
+    }
+    const SDL_Rect* placement = &state->atlas_rects[icon.texture_id];
+    if (placement->w == 0) {
+        return icon;
+    }
+    icon.texture_id = TEXTURE_ATLAS;
+    icon.source_rect.x += placement->x;
+    icon.source_rect.y += placement->y;
+    return icon;
+}
+
 void icon_tile_init(
         State* state, IconID icon_id, TexID texture_id, int32_t tile_size, int32_t x, int32_t y) {
 
-    state->icons[icon_id] = icon_tile_new(texture_id, tile_size, x, y);
+    state->icons[icon_id] = icon_placed(state, icon_tile_new(texture_id, tile_size, x, y));
 }
 
 void icon_texture_init(State* state, IconID icon_id, TexID texture_id) {
+    if (texture_id >= 0 && texture_id < TEXTURE_COUNT && state->atlas_rects[texture_id].w > 0) {
+        const SDL_Rect* placement = &state->atlas_rects[texture_id];
+        SDL_Rect source_rect = {0, 0, placement->w, placement->h};
+        state->icons[icon_id] = icon_placed(state, icon_new(texture_id, source_rect));
+        return;
+    }
+
     SDL_Texture* texture = draw_get_texture(state, texture_id);
     if (texture == NULL) {
         return;
@@ -76,3 +98,13 @@ void icon_color_mod(State* state, IconID icon_id, uint8_t r, uint8_t g, uint8_t
     const Icon* icon = &state->icons[icon_id];
     draw_texture_color_mod(state, icon->texture_id, r, g, b);
 }
+
+void icon_alpha_mod(State* state, IconID icon_id, uint8_t alpha) {
+    if (icon_id >= ICON_COUNT) {
+        WARN("Invalid icon ID.");
+        return;
+    }
+    
+    const Icon* icon = &state->icons[icon_id];
+    draw_texture_alpha_mod(state, icon->texture_id, alpha);
+}
@@ -9,61 +9,206 @@ static int32_t distance4(int32_t ax, int32_t ay, int32_t bx, int32_t by) {
     return abs(ax - bx) + abs(ay - by);
 }
 
-static bool interact(State* state, Entity subject, Coord tile_x, Coord tile_y, bool check_only) {
-    bool interacted = false;
+#define RULE_MAX_KEYS 4 /* Component types looked at on each side of a rule. */
+#define COMPBIT(comptype) ((uint16_t)1 << (comptype))
 
+typedef enum {
+    EffectMount,
+    EffectEat,
+    EffectSlay,
+} Effect;
+
+/*
+ What happens when an entity with all of the subject components moves onto one with all of the
+ target components. Rules apply in order and stop once the target is gone.
+ */
+typedef struct {
+    uint16_t subject;
+    uint16_t target;
+    Effect effect;
+} Rule;
+
+static const Rule rules[] = {
     /* knight + horse = mounted */
-    Entity mount = type_at(state, COMPTYPE_MOUNT, tile_x, tile_y);
-    bool is_rider = 
-        (component_of(&state->components.compgroups[COMPTYPE_RIDER], subject) != NULL);
-    if (mount != 0 && is_rider) {
-        if (!check_only) {
-            components_entity_end(&state->components, mount);
-            component_end(&state->components.compgroups[COMPTYPE_RIDER], subject);
+    {COMPBIT(COMPTYPE_RIDER), COMPBIT(COMPTYPE_MOUNT), EffectMount},
+    /* draggy + livestock = munch */
+    {COMPBIT(COMPTYPE_MUNCH), COMPBIT(COMPTYPE_EDIBLE), EffectEat},
+    /* knight + draggy = yay, once every draggy is gone */
+    {COMPBIT(COMPTYPE_SLAYER), COMPBIT(COMPTYPE_SLAYME), EffectSlay},
+};
+#define RULE_COUNT (sizeof(rules) / sizeof(rules[0]))
+
+/*
+ The rules compiled down to a matrix of the rules that apply to each pair of signatures. A
+ signature has one bit for each component type that any rule looks at on that side.
+ */
+static struct {
+    uint8_t subject_keys[RULE_MAX_KEYS];
+    uint8_t nsubject_keys;
+    uint8_t target_keys[RULE_MAX_KEYS];
+    uint8_t ntarget_keys;
+    uint16_t matrix[1 << RULE_MAX_KEYS][1 << RULE_MAX_KEYS]; /* Bit per rule in rules[]. */
+    SDL_atomic_t state; /* One of the DISPATCH_ values. */
+} dispatch;
+
+#define DISPATCH_EMPTY 0
+#define DISPATCH_COMPILING 1
+#define DISPATCH_READY 2
+#define DISPATCH_FAILED 3
+
+static int keys_compile(uint16_t types, uint8_t* keys, uint8_t* nkeys) {
+    *nkeys = 0;
+    for (uint8_t comptype = 0; comptype < COMPTYPE_COUNT; comptype += 1) {
+        if ((types & COMPBIT(comptype)) == 0) {
+            continue;
+        }
+        if (*nkeys >= RULE_MAX_KEYS) {
+            ERROR("Rules look at more than %d component types.", RULE_MAX_KEYS);
+            return 1;
+        }
+        keys[*nkeys] = comptype;
+        *nkeys += 1;
+    }
+    return 0;
+}
+
+static uint16_t signature_mask(uint16_t types, const uint8_t* keys, uint8_t nkeys) {
+    uint16_t result = 0;
+    for (uint8_t r = 0; r < nkeys; r += 1) {
+        if ((types & COMPBIT(keys[r])) != 0) {
+            result |= 1 << r;
+        }
+    }
+    return result;
+}
+
+static int rules_compile() {
+    if (RULE_COUNT > 16) {
+        ERROR("Too many rules.");
+        return 1;
+    }
+
+    uint16_t subject_types = 0;
+    uint16_t target_types = 0;
+    for (size_t r = 0; r < RULE_COUNT; r += 1) {
+        subject_types |= rules[r].subject;
+        target_types |= rules[r].target;
+    }
+    if (keys_compile(subject_types, dispatch.subject_keys, &dispatch.nsubject_keys) != 0) {
+        return 1;
+    }
+    if (keys_compile(target_types, dispatch.target_keys, &dispatch.ntarget_keys) != 0) {
+        return 1;
+    }
+
+    uint16_t nsubjects = 1 << dispatch.nsubject_keys;
+    uint16_t ntargets = 1 << dispatch.ntarget_keys;
+    for (uint16_t s = 0; s < nsubjects; s += 1) {
+        for (uint16_t t = 0; t < ntargets; t += 1) {
+            uint16_t applicable = 0;
+            for (size_t r = 0; r < RULE_COUNT; r += 1) {
+                uint16_t need_s = signature_mask(
+                    rules[r].subject, dispatch.subject_keys, dispatch.nsubject_keys);
+                uint16_t need_t = signature_mask(
+                    rules[r].target, dispatch.target_keys, dispatch.ntarget_keys);
+                if ((s & need_s) == need_s && (t & need_t) == need_t) {
+                    applicable |= 1 << r;
+                }
+            }
+            dispatch.matrix[s][t] = applicable;
+        }
+    }
+    return 0;
+}
 
-            CAvatar* avatar =
-                (CAvatar*)component_of(&state->components.compgroups[COMPTYPE_AVATAR], subject);
+/*
+ Compiles the rules the first time that any thread needs them. The others wait for it to finish,
+ which only takes a moment.
+ Returns: true if the dispatch matrix can be used
+ */
+static bool rules_ready() {
+    int state = SDL_AtomicGet(&dispatch.state);
+    if (state == DISPATCH_EMPTY
+            && SDL_AtomicCAS(&dispatch.state, DISPATCH_EMPTY, DISPATCH_COMPILING)) {
+        state = rules_compile() == 0 ? DISPATCH_READY : DISPATCH_FAILED;
+        SDL_AtomicSet(&dispatch.state, state);
+        if (state == DISPATCH_FAILED) {
+            ERROR("rules_compile");
+        }
+    }
+    while (state == DISPATCH_EMPTY || state == DISPATCH_COMPILING) {
+        state = SDL_AtomicGet(&dispatch.state);
+    }
+    return state == DISPATCH_READY;
+}
+
+static uint16_t signature(Components* comps, Entity entity, const uint8_t* keys, uint8_t nkeys) {
+    uint16_t result = 0;
+    for (uint8_t r = 0; r < nkeys; r += 1) {
+        if (component_of(&comps->compgroups[keys[r]], entity) != NULL) {
+            result |= 1 << r;
+        }
+    }
+    return result;
+}
+
+static void effect_apply(
+        Components* comps, Entity subject, Entity target, Effect effect, Outcome* outcome) {
+    switch (effect) {
+        case EffectMount: {
+            components_entity_end(comps, target);
+            component_end(&comps->compgroups[COMPTYPE_RIDER], subject);
+
+            CAvatar* avatar = (CAvatar*)component_of(&comps->compgroups[COMPTYPE_AVATAR], subject);
 
             if (avatar != NULL) {
                 avatar->icon_id = ICON_MKNIGHT;
             }
-            slayer_init(&state->components, subject);
+            slayer_init(comps, subject);
+            break;
         }
-        
-        interacted = true;
+        case EffectEat:
+            components_entity_end(comps, target);
+            *outcome = OutcomeLost;
+            break;
+        case EffectSlay:
+            components_entity_end(comps, target);
+            if (comps->compgroups[COMPTYPE_SLAYME].alive == 0) {
+                *outcome = OutcomeWon;
+            }
+            break;
     }
+}
 
-    /* draggy + livestock = munch */
-    Entity edible = type_at(state, COMPTYPE_EDIBLE, tile_x, tile_y);
-    bool is_munch =
-        (component_of(&state->components.compgroups[COMPTYPE_MUNCH], subject) != NULL);
-    if (edible != 0 && is_munch) {
-        if (!check_only) {
-            components_entity_end(&state->components, edible);
-            state->game_over = true;
-        }
-        
-        interacted = true;
+static bool interact(
+        Components* comps, Entity subject, Coord tile_x, Coord tile_y, bool check_only,
+        Outcome* outcome) {
+    if (!rules_ready()) {
+        return false;
+    }
+
+    size_t tile = tile_y * TILES_ACROSS + tile_x;
+    Entity target = comps->tiles[tile];
+    if (target == 0 || target == subject) {
+        return false;
+    }
+
+    uint16_t s = signature(comps, subject, dispatch.subject_keys, dispatch.nsubject_keys);
+    uint16_t t = signature(comps, target, dispatch.target_keys, dispatch.ntarget_keys);
+    uint16_t applicable = dispatch.matrix[s][t];
+    if (applicable == 0 || check_only) {
+        return applicable != 0;
     }
 
-    /* knight + draggy = yay */
-    Entity slayme = type_at(state, COMPTYPE_SLAYME, tile_x, tile_y);
-    bool is_slayer =
-        (component_of(&state->components.compgroups[COMPTYPE_SLAYER], subject) != NULL);
-    if (slayme != 0 && is_slayer) {
-        if (!check_only) {
-            components_entity_end(&state->components, slayme);
-            state->game_over = true;
-            state->won = true;
+    for (size_t r = 0; r < RULE_COUNT && comps->tiles[tile] == target; r += 1) {
+        if ((applicable & (1 << r)) != 0) {
+            effect_apply(comps, subject, target, rules[r].effect, outcome);
         }
-        
-        interacted = true;
     }
-    
-    return interacted;
+    return true;
 }
 
-static bool munch_allowed(State* state, Coord start_x, Coord start_y, Coord dx, Coord dy) {
+static bool munch_allowed(Components* comps, Coord start_x, Coord start_y, Coord dx, Coord dy) {
     if (!(dx == 0 || dy == 0)) {
         ERROR("Can't trace non-orthogonal path [x=%d y=%d]", dx, dy);
         return false;
@@ -72,12 +217,12 @@ static bool munch_allowed(State* state, Coord start_x, Coord start_y, Coord dx,
     bool edible_visible = false;
 
     CompGroup* groups[] = {
-        &state->components.compgroups[COMPTYPE_EDIBLE],
-        &state->components.compgroups[COMPTYPE_POSITION],
+        &comps->compgroups[COMPTYPE_EDIBLE],
+        &comps->compgroups[COMPTYPE_POSITION],
     };
-    void* comps[] = {NULL, NULL};
-    while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
-        CPosition* position = (CPosition*)comps[1];
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
 
         if (position->y == start_y) {
             if (dx > 0 && (position->x > start_x)) {
@@ -112,7 +257,9 @@ typedef struct {
     Coord dy;
 } Activity;
 
-static Activity do_move(State* state, Entity subject, Coord tile_x, Coord tile_y, bool check_only) {
+static Activity do_move(
+        Components* comps, Entity subject, Coord tile_x, Coord tile_y, bool check_only,
+        Outcome* outcome) {
     Activity result = {false, false, 0, 0};
     
     if (subject == 0) {
@@ -124,7 +271,7 @@ static Activity do_move(State* state, Entity subject, Coord tile_x, Coord tile_y
     }
 
     /* Starting position. */
-    CPosition* position = component_of(&state->components.compgroups[COMPTYPE_POSITION], subject);
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], subject);
     if (position == NULL) {
         ERROR("Subject position component is missing.");
         return result;
@@ -141,17 +288,16 @@ static Activity do_move(State* state, Entity subject, Coord tile_x, Coord tile_y
     position = NULL; /* The pointer can invalidate if components are removed so don't reuse. */
 
     /* Draggy only toward food. */
-    bool is_munch =
-        (component_of(&state->components.compgroups[COMPTYPE_MUNCH], subject) != NULL);
+    bool is_munch = (component_of(&comps->compgroups[COMPTYPE_MUNCH], subject) != NULL);
     if (is_munch) {
-        if (!munch_allowed(state, start_x, start_y, dx, dy)) {
+        if (!munch_allowed(comps, start_x, start_y, dx, dy)) {
             return result;
         }
     }
     
     /* Interact. */
-    bool interacted = interact(state, subject, tile_x, tile_y, check_only);
-    if (!interacted && type_at(state, COMPTYPE_OBSTRUCTION, tile_x, tile_y) != 0) {
+    bool interacted = interact(comps, subject, tile_x, tile_y, check_only, outcome);
+    if (!interacted && type_at(comps, COMPTYPE_OBSTRUCTION, tile_x, tile_y) != 0) {
         return result;
     }
     result.interacted = true;
@@ -160,34 +306,23 @@ static Activity do_move(State* state, Entity subject, Coord tile_x, Coord tile_y
     result.moved = true;
     if (!check_only) {
         /* Need to get position component again because the ECS can have been rearranged. */
-        position = component_of(&state->components.compgroups[COMPTYPE_POSITION], subject);
+        position = component_of(&comps->compgroups[COMPTYPE_POSITION], subject);
         if (position == NULL) {
             ERROR("Subject position component is missing.");
             return result;
         }
         
-        position->x = tile_x;
-        position->y = tile_y;
+        position_set(comps, position, tile_x, tile_y);
     }
 
     /* Go on cooldown. */
-    bool is_selectable =
-        (component_of(&state->components.compgroups[COMPTYPE_SELECTABLE], subject) != NULL);
+    bool is_selectable = (component_of(&comps->compgroups[COMPTYPE_SELECTABLE], subject) != NULL);
     if (is_selectable && !check_only) {
-        if (cooldown_init(&state->components, subject) == NULL) {
-            ERROR("cooldown_init");
-        }
-
-        /* Clear cooldowns when last piece moves. */
-        if (state->components.compgroups[COMPTYPE_COOLDOWN].alive
-        >= state->components.compgroups[COMPTYPE_SELECTABLE].alive) {
-            compgroup_clear(&state->components.compgroups[COMPTYPE_COOLDOWN]);
-        }
+        cooldown_start(comps, subject);
     }
 
     /* Signal herding behavior. */
-    bool is_herder =
-        (component_of(&state->components.compgroups[COMPTYPE_HERDER], subject) != NULL);
+    bool is_herder = (component_of(&comps->compgroups[COMPTYPE_HERDER], subject) != NULL);
     if (is_herder) {
         result.herded = true;
         result.dx = dx;
@@ -199,50 +334,119 @@ static Activity do_move(State* state, Entity subject, Coord tile_x, Coord tile_y
 
 typedef struct {
     Entity entity;
-    int32_t dest_x;
-    int32_t dest_y;
+    int32_t order; /* Distance along the push, so the frontmost sheep has the highest. */
 } HerdMe;
 
-static void herd(State* state, Coord dx, Coord dy) {
-    size_t max_herdmes = 10;
-    HerdMe herdus[max_herdmes];
-    memset(herdus, 0, max_herdmes * sizeof(HerdMe));
-    size_t next_herdme = 0;
+static int compare_herdme(const void* a, const void* b) {
+    const HerdMe* left = (const HerdMe*)a;
+    const HerdMe* right = (const HerdMe*)b;
+    if (left->order != right->order) {
+        return left->order > right->order ? -1 : 1;
+    }
+    return left->entity < right->entity ? -1 : left->entity > right->entity;
+}
+
+static Bitboard tile_bit(Coord x, Coord y) {
+    return (Bitboard)1 << (y * TILES_ACROSS + x);
+}
+
+/* Whether a flock member does anything besides get in the way when it moves. */
+static bool is_plain_flock(Components* comps, Entity entity) {
+    uint8_t comptypes[] = {
+        COMPTYPE_SELECTABLE, COMPTYPE_RIDER, COMPTYPE_MUNCH, COMPTYPE_SLAYER, COMPTYPE_HERDER,
+    };
+    for (size_t r = 0; r < sizeof(comptypes); r += 1) {
+        if (component_of(&comps->compgroups[comptypes[r]], entity) != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ Sheep are moved front to back along the push so that a sheep that's in the way of another has
+ already moved on, or stayed put, by the time the one behind it moves. Plain sheep can only be
+ blocked, so they're moved against a bitboard of the occupied tiles that's kept up to date as they
+ go instead of checked piece by piece through do_move().
+ */
+static void herd(Components* comps, Coord dx, Coord dy, Outcome* outcome) {
+    CompGroup* flock = &comps->compgroups[COMPTYPE_FLOCK];
+    if (flock->alive == 0) {
+        return;
+    }
+    HerdMe herdus[flock->alive];
+    size_t nherdus = 0;
 
     CompGroup* groups[] = {
-        &state->components.compgroups[COMPTYPE_FLOCK],
-        &state->components.compgroups[COMPTYPE_POSITION],
+        flock,
+        &comps->compgroups[COMPTYPE_POSITION],
     };
-    void* comps[] = {NULL, NULL};
-    while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
-        CPosition* position = (CPosition*)comps[1];
-
-        herdus[next_herdme] = (HerdMe){position->entity, position->x + dx, position->y + dy};
-        next_herdme += 1;
-        if (next_herdme >= max_herdmes) {
-            WARN("Too many entities to herd.");
-            break;
-        }        
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        herdus[nherdus] = (HerdMe){position->entity, position->x * dx + position->y * dy};
+        nherdus += 1;
     }
-    
-    for (size_t r = 0; r < max_herdmes; r += 1) {
-        if (herdus[r].entity == 0) {
-            break;
+    qsort(herdus, nherdus, sizeof(HerdMe), compare_herdme);
+
+    Bitboard occupied = type_bits(comps, COMPTYPE_OBSTRUCTION);
+    for (size_t r = 0; r < nherdus; r += 1) {
+        Entity entity = herdus[r].entity;
+        CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], entity);
+        if (position == NULL) {
+            continue; /* Removed by an earlier move. */
         }
-        
-        do_move(state, herdus[r].entity, herdus[r].dest_x, herdus[r].dest_y, false);
+        Coord dest_x = position->x + dx;
+        Coord dest_y = position->y + dy;
+
+        if (!is_plain_flock(comps, entity)) {
+            do_move(comps, entity, dest_x, dest_y, false, outcome);
+            occupied = type_bits(comps, COMPTYPE_OBSTRUCTION);
+            continue;
+        }
+        if (!in_board(dest_x, dest_y) || (occupied & tile_bit(dest_x, dest_y)) != 0) {
+            continue;
+        }
+        if (component_of(&comps->compgroups[COMPTYPE_OBSTRUCTION], entity) != NULL) {
+            occupied &= ~tile_bit(position->x, position->y);
+            occupied |= tile_bit(dest_x, dest_y);
+        }
+        position_set(comps, position, dest_x, dest_y);
     }
 }
 
-void command_move(State* state, Entity subject, Coord tile_x, Coord tile_y) {
+Outcome components_command_move(Components* comps, Entity subject, Coord tile_x, Coord tile_y) {
+    Outcome outcome = OutcomeMoved;
+    Activity activity = do_move(comps, subject, tile_x, tile_y, false, &outcome);
+    if (!activity.moved) {
+        return OutcomeInvalid;
+    }
+    if (activity.herded) {
+        herd(comps, activity.dx, activity.dy, &outcome);
+    }
+    comps->nmoves += 1;
+    return outcome;
+}
+
+bool components_will_move(Components* comps, Entity subject, Coord tile_x, Coord tile_y) {
+    Outcome outcome = OutcomeMoved;
+    Activity activity = do_move(comps, subject, tile_x, tile_y, true, &outcome);
+    return activity.interacted;
+}
+
+Outcome command_move(State* state, Entity subject, Coord tile_x, Coord tile_y) {
     if (state->game_over) {
-        return;
+        return OutcomeInvalid;
     }
     
-    Activity activity = do_move(state, subject, tile_x, tile_y, false);
-    if (activity.herded) {
-        herd(state, activity.dx, activity.dy);
+    Outcome outcome = components_command_move(&state->components, subject, tile_x, tile_y);
+    if (outcome == OutcomeLost) {
+        state->game_over = true;
+    } else if (outcome == OutcomeWon) {
+        state->game_over = true;
+        state->won = true;
     }
+    return outcome;
 }
 
 bool will_move(State* state, Entity subject, Coord tile_x, Coord tile_y) {
@@ -250,6 +454,5 @@ bool will_move(State* state, Entity subject, Coord tile_x, Coord tile_y) {
         return false;
     }
     
-    Activity activity = do_move(state, subject, tile_x, tile_y, true);
-    return activity.interacted;
+    return components_will_move(&state->components, subject, tile_x, tile_y);
 }
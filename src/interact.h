@@ -1,4 +1,16 @@
 
-void command_move(State* state, Entity subject, Coord tile_x, Coord tile_y);
+/*
+ Returns: OutcomeInvalid if the move isn't allowed, otherwise the result of the move.
+ */
+Outcome command_move(State* state, Entity subject, Coord tile_x, Coord tile_y);
 
 bool will_move(State* state, Entity subject, Coord tile_x, Coord tile_y);
+
+/*
+ Applies the move rules to a bare set of components, without any of the game's display state, so
+ that the rules can be run headlessly.
+ Returns: OutcomeInvalid if the move isn't allowed, otherwise the result of the move.
+ */
+Outcome components_command_move(Components* comps, Entity subject, Coord tile_x, Coord tile_y);
+
+bool components_will_move(Components* comps, Entity subject, Coord tile_x, Coord tile_y);
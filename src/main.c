@@ -1,5 +1,6 @@
 #ifndef TEST
 
+#include <string.h>
 #include "SDL.h"
 #include "logging.h"
 #include "entity.h"
@@ -16,6 +17,12 @@
 #include "interact.h"
 #include "tween.h"
 #include "audio.h"
+#include "generate.h"
+#include "count.h"
+#include "tablebase.h"
+#include "solve.h"
+#include "ai.h"
+#include "assets.h"
 
 #include "res/terrain.h"
 #define RES_TILES __res_Tiny_Top_Down_32x32_png
@@ -99,6 +106,13 @@ int renderer_init(State* state) {
     }
     state->renderer = renderer;
 
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) != 0) {
+        WARN("SDL_GetRendererInfo");
+    } else {
+        state->vsync = (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+    }
+
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
     if (SDL_RenderSetLogicalSize(renderer, VIEW_WIDTH, VIEW_HEIGHT) != 0) {
@@ -109,69 +123,30 @@ int renderer_init(State* state) {
     return 0;
 }
 
-int textures_init(State* state) {
-    if (texture_load_const_png(state, TEXTURE_TILES, RES_TILES, sizeof(RES_TILES)) != 0) {
-        ERROR("texture_load_const_png (tiles)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_DRAGON, RES_DRAGON, sizeof(RES_DRAGON)) != 0) {
-        ERROR("texture_load_const_png (dragon)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_KNIGHT, RES_KNIGHT, sizeof(RES_KNIGHT)) != 0) {
-        ERROR("texture_load_const_png (knight)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_MKNIGHT, RES_MKNIGHT, sizeof(RES_MKNIGHT)) != 0) {
-        ERROR("texture_load_const_png (mounted knight)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_SHEEP, RES_SHEEP, sizeof(RES_SHEEP)) != 0) {
-        ERROR("texture_load_const_png (sheep)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_DOG, RES_DOG, sizeof(RES_DOG)) != 0) {
-        ERROR("texture_load_const_png (dog)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_HORSE, RES_HORSE, sizeof(RES_HORSE)) != 0) {
-        ERROR("texture_load_const_png (horse)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_COOLDOWN, RES_COOLDOWN, sizeof(RES_COOLDOWN)) != 0) {
-        ERROR("texture_load_const_png (cooldown)");
-        return 1;
-    }
-    if (texture_load_const_png(
-            state, TEXTURE_INSTRUCTIONS, RES_INSTRUCTIONS, sizeof(RES_INSTRUCTIONS)) != 0) {
-        ERROR("texture_load_const_png (instructions)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_SUCCESS, RES_SUCCESS, sizeof(RES_SUCCESS)) != 0) {
-        ERROR("texture_load_const_png (cooldown)");
-        return 1;
-    }
-    if (texture_load_const_png(state, TEXTURE_FAILURE, RES_FAILURE, sizeof(RES_FAILURE)) != 0) {
-        ERROR("texture_load_const_png (cooldown)");
-        return 1;
-    }
-    
-    icon_texture_init(state, ICON_DRAGON, TEXTURE_DRAGON);
-    icon_texture_init(state, ICON_KNIGHT, TEXTURE_KNIGHT);
-    icon_texture_init(state, ICON_MKNIGHT, TEXTURE_MKNIGHT);
-    icon_texture_init(state, ICON_SHEEP, TEXTURE_SHEEP);
-    icon_texture_init(state, ICON_DOG, TEXTURE_DOG);
-    icon_texture_init(state, ICON_HORSE, TEXTURE_HORSE);
-    icon_texture_init(state, ICON_COOLDOWN, TEXTURE_COOLDOWN);
-    icon_texture_init(state, ICON_INSTRUCTIONS, TEXTURE_INSTRUCTIONS);
-    icon_texture_init(state, ICON_SUCCESS, TEXTURE_SUCCESS);
-    icon_texture_init(state, ICON_FAILURE, TEXTURE_FAILURE);
-
-    /* TODO: Should unload IMG in response to an event or something. */
-    draw_loading_done();
+static const AtlasImage sprite_images[] = {
+    {TEXTURE_TILES, "tiles", RES_TILES, sizeof(RES_TILES)},
+    {TEXTURE_DRAGON, "dragon", RES_DRAGON, sizeof(RES_DRAGON)},
+    {TEXTURE_KNIGHT, "knight", RES_KNIGHT, sizeof(RES_KNIGHT)},
+    {TEXTURE_MKNIGHT, "mounted knight", RES_MKNIGHT, sizeof(RES_MKNIGHT)},
+    {TEXTURE_SHEEP, "sheep", RES_SHEEP, sizeof(RES_SHEEP)},
+    {TEXTURE_DOG, "dog", RES_DOG, sizeof(RES_DOG)},
+    {TEXTURE_HORSE, "horse", RES_HORSE, sizeof(RES_HORSE)},
+    {TEXTURE_COOLDOWN, "cooldown", RES_COOLDOWN, sizeof(RES_COOLDOWN)},
+};
 
-    return 0;
-}
+/* Not needed for the first frame so they're decoded in the background. See text_poll() */
+static const AtlasImage caption_images[] = {
+    {TEXTURE_INSTRUCTIONS, "instructions", RES_INSTRUCTIONS, sizeof(RES_INSTRUCTIONS)},
+    {TEXTURE_SUCCESS, "success", RES_SUCCESS, sizeof(RES_SUCCESS)},
+    {TEXTURE_FAILURE, "failure", RES_FAILURE, sizeof(RES_FAILURE)},
+};
+
+static const AssetsSource assets_source = {
+    .sprites = sprite_images,
+    .nsprites = sizeof(sprite_images) / sizeof(sprite_images[0]),
+    .captions = caption_images,
+    .ncaptions = sizeof(caption_images) / sizeof(caption_images[0]),
+};
 
 /*
  apparently SDL_CreateWindow still works if SDL_Init is omitted
@@ -191,12 +166,15 @@ int run(State* state) {
     if (renderer_init(state) != 0) {
         return 1;
     }
-    if (textures_init(state) != 0) {
+    if (assets_init(state, &assets_source) != 0) {
         return 1;
     }
     if (terrain_init(state) != 0) {
         return 1;
     }
+    if (draw_init(state) != 0) {
+        return 1;
+    }
     if (audio_init(state) != 0) {
         return 1;
     }
@@ -208,11 +186,60 @@ int run(State* state) {
 }
 
 int main(int argc, char* argv[]) {
+    uint32_t ai_budget = 0;
+    if (argc > 2 && strcmp(argv[1], "--ai") == 0) {
+        ai_budget = (uint32_t)strtoul(argv[2], NULL, 10);
+        if (ai_budget == 0) {
+            ERROR("Usage: --ai MILLISECONDS");
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "generate") == 0) {
+        return generate_main(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "count") == 0) {
+        return count_main(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "solve") == 0) {
+        return solve_main(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "tablebase") == 0) {
+        return tablebase_main(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "bake") == 0) {
+        return assets_main(&assets_source, argc - 2, argv + 2);
+    }
+
     State* state = state_new();
     if (state == NULL) {
         ERROR("state_new");
         return 1;
     }
+    if (ai_budget > 0) {
+        state->ai.enabled = true;
+        state->ai.budget = ai_budget;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "play") == 0) {
+        state->level_pack = level_pack_load(argv[2]);
+        state->level_count = state->level_pack != NULL ? level_pack_count(state->level_pack) : 0;
+        if (state->level_count == 0) {
+            ERROR("No levels in %s.", argv[2]);
+            state_end(state);
+            return 1;
+        }
+
+        for (int r = 3; r < argc && state->ntablebases < TABLEBASE_MAX_LOADED; r += 1) {
+            if (tablebase_load(&state->tablebases[state->ntablebases], argv[r]) != 0) {
+                WARN("tablebase_load");
+                continue;
+            }
+            state->ntablebases += 1;
+        }
+    }
 
     int status = run(state);
 
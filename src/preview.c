@@ -0,0 +1,172 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "draw.h"
+#include "icon.h"
+#include "interact.h"
+#include "render.h"
+#include "preview.h"
+
+/* Terrain never changes during a move and tweens only matter to the real board. */
+#define PREVIEW_COMPTYPES \
+    ((((uint32_t)1 << COMPTYPE_COUNT) - 1) \
+        & ~((uint32_t)1 << COMPTYPE_TILE) & ~((uint32_t)1 << COMPTYPE_TWEEN))
+
+#define PREVIEW_GHOST_ALPHA 120
+
+RGBA color_preview_gone = {35, 40, 35, 105};
+RGBA color_preview_lost = {150, 70, 60, 150};
+
+Outcome preview_move(
+        Components* view, const Components* comps, Entity subject, Coord tile_x, Coord tile_y) {
+    if (components_copy_some(view, comps, PREVIEW_COMPTYPES) != 0) {
+        ERROR("components_copy_some");
+        return OutcomeInvalid;
+    }
+    return components_command_move(view, subject, tile_x, tile_y);
+}
+
+int preview_init(State* state) {
+    state->preview.view = components_new();
+    return 0;
+}
+
+void preview_end(State* state) {
+    components_free(&state->preview.view);
+}
+
+void preview_clear(State* state) {
+    Preview* preview = &state->preview;
+    preview->subject = 0;
+    preview->outcome = OutcomeInvalid;
+    preview->tiles = 0;
+}
+
+static Bitboard tile_bit(Coord x, Coord y) {
+    return (Bitboard)1 << (y * TILES_ACROSS + x);
+}
+
+/* The tiles that preview_draw() shades or draws a ghost on. */
+static Bitboard preview_footprint(Components* comps, Components* view) {
+    Bitboard result = 0;
+    CompGroup* groups[] = {
+        &comps->compgroups[COMPTYPE_AVATAR],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        if (component_of(&view->compgroups[COMPTYPE_POSITION], position->entity) == NULL) {
+            result |= tile_bit(position->x, position->y);
+        }
+    }
+
+    CompGroup* view_groups[] = {
+        &view->compgroups[COMPTYPE_AVATAR],
+        &view->compgroups[COMPTYPE_POSITION],
+    };
+    void* view_iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&view_groups, (void**)&view_iter, 2)) {
+        CPosition* position = (CPosition*)view_iter[1];
+        CPosition* actual = component_of(&comps->compgroups[COMPTYPE_POSITION], position->entity);
+        if (actual == NULL || actual->x != position->x || actual->y != position->y) {
+            result |= tile_bit(position->x, position->y);
+        }
+    }
+    return result;
+}
+
+/*
+ Works the move out again only when the hovered move or the board has changed since last time. The
+ round and the count of pieces that moved in it aren't enough to tell: a piece that slays one that
+ already moved this round leaves both the same.
+ */
+void preview_update(State* state) {
+    Preview* preview = &state->preview;
+    Selection* sel = &state->selection;
+    Components* comps = &state->components;
+    if (sel->subject == 0 || sel->hover_x < 0 || sel->hover_y < 0 || state->game_over) {
+        preview_clear(state);
+        return;
+    }
+    if (preview->subject == sel->subject && preview->x == sel->hover_x
+            && preview->y == sel->hover_y && preview->nmoves == comps->nmoves) {
+        return;
+    }
+
+    preview->subject = sel->subject;
+    preview->x = sel->hover_x;
+    preview->y = sel->hover_y;
+    preview->nmoves = comps->nmoves;
+    preview->outcome = preview_move(&preview->view, comps, sel->subject, sel->hover_x,
+        sel->hover_y);
+    preview->tiles = 0;
+    if (preview->outcome != OutcomeInvalid) {
+        preview->tiles = preview_footprint(comps, &preview->view);
+    }
+}
+
+static void tile_fill(State* state, Coord tile_x, Coord tile_y) {
+    SDL_Rect rect = {
+        .x = tile_x * TILE_SIZE,
+        .y = tile_y * TILE_SIZE,
+        .w = TILE_SIZE,
+        .h = TILE_SIZE,
+    };
+    draw_fill_rect(state, &rect);
+}
+
+static void ghost_draw(State* state, IconID icon_id, Coord tile_x, Coord tile_y) {
+    SDL_Rect dest_rect = {
+        .x = tile_x * TILE_SIZE,
+        .y = tile_y * TILE_SIZE,
+        .w = TILE_SIZE,
+        .h = TILE_SIZE,
+    };
+    icon_alpha_mod(state, icon_id, PREVIEW_GHOST_ALPHA);
+    icon_draw(state, icon_id, &dest_rect);
+    icon_alpha_mod(state, icon_id, 255);
+}
+
+void preview_draw(State* state) {
+    preview_update(state);
+    Preview* preview = &state->preview;
+    if (preview->subject == 0 || preview->outcome == OutcomeInvalid) {
+        return;
+    }
+    Components* comps = &state->components;
+    Components* view = &preview->view;
+
+    /* Pieces that the move would take off the board. */
+    RGBA gone = preview->outcome == OutcomeLost ? color_preview_lost : color_preview_gone;
+    draw_set_color(state, gone);
+    CompGroup* groups[] = {
+        &comps->compgroups[COMPTYPE_AVATAR],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        if (component_of(&view->compgroups[COMPTYPE_POSITION], position->entity) == NULL) {
+            tile_fill(state, position->x, position->y);
+        }
+    }
+
+    /* Ghosts of the pieces that would end up somewhere else, over what they'd take. */
+    render_layer(state, LAYER_PREVIEW_GHOST);
+    CompGroup* view_groups[] = {
+        &view->compgroups[COMPTYPE_AVATAR],
+        &view->compgroups[COMPTYPE_POSITION],
+    };
+    void* view_iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&view_groups, (void**)&view_iter, 2)) {
+        CAvatar* avatar = (CAvatar*)view_iter[0];
+        CPosition* position = (CPosition*)view_iter[1];
+        CPosition* actual = component_of(&comps->compgroups[COMPTYPE_POSITION], avatar->entity);
+        if (actual == NULL || actual->x != position->x || actual->y != position->y) {
+            ghost_draw(state, avatar->icon_id, position->x, position->y);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+
+int preview_init(State* state);
+
+void preview_end(State* state);
+
+void preview_clear(State* state);
+
+/*
+ Works out what the hovered move would do if that's changed. Sets state->preview.tiles to where it
+ will be drawn.
+ */
+void preview_update(State* state);
+
+/*
+ Shows what moving the selected piece to the hovered tile would do: ghosts of the pieces at the
+ tiles they'd end up on, including the sheep that would be herded, and shading over the pieces
+ that would be taken off the board.
+ */
+void preview_draw(State* state);
+
+/*
+ Plays the move on view, a copy of only the component groups that moves look at, and leaves comps
+ alone.
+ Returns: OutcomeInvalid if the move isn't allowed, otherwise the result of the move.
+ */
+Outcome preview_move(
+    Components* view, const Components* comps, Entity subject, Coord tile_x, Coord tile_y);
@@ -0,0 +1,218 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "batch.h"
+#include "render.h"
+
+/* Where the texture sorts in the key when it isn't a sprite's. */
+#define RENDER_SLOT_OTHER TEXTURE_COUNT
+#define RENDER_SLOT_FILL (TEXTURE_COUNT + 1)
+
+void render_begin(State* state) {
+    RenderQueue* queue = &state->render;
+    queue->queueing = true;
+    queue->layer = 0;
+    queue->ncommands = 0;
+    queue->ncolors = 0;
+    queue->drawn = NULL;
+    memset(&queue->stats, 0, sizeof(RenderStats));
+}
+
+void render_layer(State* state, Layer layer) {
+    state->render.layer = layer;
+}
+
+bool render_pause(State* state) {
+    bool queueing = state->render.queueing;
+    state->render.queueing = false;
+    return queueing;
+}
+
+void render_resume(State* state, bool queueing) {
+    state->render.queueing = queueing;
+}
+
+void render_count_draw(State* state, SDL_Texture* texture) {
+    RenderQueue* queue = &state->render;
+    queue->stats.draw_calls += 1;
+    if (texture != NULL && texture != queue->drawn) {
+        queue->stats.texture_changes += 1;
+        queue->drawn = texture;
+    }
+}
+
+const RenderStats* render_stats(State* state) {
+    return &state->render.last;
+}
+
+static bool color_equal(SDL_Color a, SDL_Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/*
+ Returns: Where the fill color sorts in the key. Colors sort in the order that they're first used
+ in, and any past RENDER_MAX_COLORS share the last place.
+ */
+static uint16_t color_slot(RenderQueue* queue, SDL_Color color) {
+    for (uint16_t r = 0; r < queue->ncolors; r += 1) {
+        if (color_equal(queue->colors[r], color)) {
+            return r;
+        }
+    }
+    if (queue->ncolors >= RENDER_MAX_COLORS) {
+        return RENDER_MAX_COLORS;
+    }
+    queue->colors[queue->ncolors] = color;
+    queue->ncolors += 1;
+    return queue->ncolors - 1;
+}
+
+void render_sort(RenderKey* keys, RenderKey* scratch, uint32_t count) {
+    if (count < 2) {
+        return;
+    }
+
+    /* Least significant byte first. Each pass is stable so the earlier ones' order holds. */
+    RenderKey* from = keys;
+    RenderKey* to = scratch;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t offsets[256];
+        memset(offsets, 0, sizeof(offsets));
+        for (uint32_t r = 0; r < count; r += 1) {
+            offsets[(from[r].key >> shift) & 0xFF] += 1;
+        }
+        if (offsets[(from[0].key >> shift) & 0xFF] == count) {
+            continue; /* All the same in this byte, which is most of them. */
+        }
+
+        uint32_t total = 0;
+        for (uint32_t r = 0; r < 256; r += 1) {
+            uint32_t n = offsets[r];
+            offsets[r] = total;
+            total += n;
+        }
+        for (uint32_t r = 0; r < count; r += 1) {
+            uint32_t digit = (from[r].key >> shift) & 0xFF;
+            to[offsets[digit]] = from[r];
+            offsets[digit] += 1;
+        }
+
+        RenderKey* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != keys) {
+        memcpy(keys, from, count * sizeof(RenderKey));
+    }
+}
+
+/*
+ Draws what's queued in order of the keys and empties the queue.
+ */
+static void render_drain(State* state) {
+    RenderQueue* queue = &state->render;
+    render_sort(queue->keys, queue->scratch, queue->ncommands);
+
+    bool color_set = false;
+    SDL_Color color = {0, 0, 0, 0};
+    for (uint32_t r = 0; r < queue->ncommands; r += 1) {
+        RenderCommand* command = &queue->commands[queue->keys[r].index];
+        if (command->kind == RenderSprite) {
+            batch_add(state, command->texture_id, &command->source_rect, &command->dest_rect,
+                command->color);
+            continue;
+        }
+
+        batch_flush(state);
+        if (command->kind == RenderFill) {
+            if (!color_set || !color_equal(color, command->color)) {
+                color = command->color;
+                color_set = true;
+                if (SDL_SetRenderDrawColor(
+                        state->renderer, color.r, color.g, color.b, color.a) != 0) {
+                    WARN("SDL_SetRenderDrawColor");
+                }
+                queue->stats.color_changes += 1;
+            }
+            if (SDL_RenderFillRect(state->renderer, &command->dest_rect) != 0) {
+                WARN("SDL_RenderFillRect");
+            }
+            render_count_draw(state, NULL);
+        } else {
+            const SDL_Rect* dest_rect = command->whole ? NULL : &command->dest_rect;
+            if (SDL_RenderCopy(state->renderer, command->texture, NULL, dest_rect) != 0) {
+                WARN("SDL_RenderCopy");
+            }
+            render_count_draw(state, command->texture);
+        }
+    }
+    batch_flush(state);
+
+    queue->ncommands = 0;
+    queue->ncolors = 0;
+}
+
+void render_submit(State* state) {
+    RenderQueue* queue = &state->render;
+    render_drain(state);
+    queue->queueing = false;
+    queue->last = queue->stats;
+}
+
+/*
+ Returns: A command to fill in, already in the queue.
+ */
+static RenderCommand* render_push(State* state, uint16_t texture_slot, uint16_t color_slot) {
+    RenderQueue* queue = &state->render;
+    if (queue->ncommands >= RENDER_MAX_COMMANDS) {
+        /* Layers only stay in order within what's drawn together, but it's better than nothing. */
+        WARN("Render queue full.");
+        render_drain(state);
+    }
+
+    uint32_t index = queue->ncommands;
+    queue->ncommands += 1;
+    queue->stats.commands += 1;
+    queue->keys[index].key =
+        ((uint32_t)queue->layer << 24) | ((uint32_t)texture_slot << 16) | color_slot;
+    queue->keys[index].index = index;
+    return &queue->commands[index];
+}
+
+void render_sprite(State* state, TexID texture_id, const SDL_Rect* source_rect,
+        const SDL_Rect* dest_rect, SDL_Color color) {
+    if (texture_id < 0 || texture_id >= TEXTURE_COUNT) {
+        WARN("Invalid texture ID %d.", texture_id);
+        return;
+    }
+    RenderCommand* command = render_push(state, (uint16_t)texture_id, 0);
+    command->kind = RenderSprite;
+    command->texture_id = texture_id;
+    command->color = color;
+    command->source_rect = *source_rect;
+    command->dest_rect = *dest_rect;
+}
+
+void render_fill(State* state, const SDL_Rect* dest_rect, SDL_Color color) {
+    uint16_t slot = color_slot(&state->render, color);
+    RenderCommand* command = render_push(state, RENDER_SLOT_FILL, slot);
+    command->kind = RenderFill;
+    command->color = color;
+    command->dest_rect = *dest_rect;
+}
+
+void render_copy(State* state, TexID texture_id, SDL_Texture* texture, const SDL_Rect* dest_rect) {
+    uint16_t slot = RENDER_SLOT_OTHER;
+    if (texture_id >= 0 && texture_id < TEXTURE_COUNT) {
+        slot = (uint16_t)texture_id;
+    }
+    RenderCommand* command = render_push(state, slot, 0);
+    command->kind = RenderCopy;
+    command->texture = texture;
+    command->whole = dest_rect == NULL;
+    if (dest_rect != NULL) {
+        command->dest_rect = *dest_rect;
+    }
+}
@@ -0,0 +1,49 @@
+
+/*
+ Starts queueing what the systems draw instead of drawing it right away.
+ */
+void render_begin(State* state);
+
+/*
+ Sets the layer that what's queued from now on is drawn in.
+ */
+void render_layer(State* state, Layer layer);
+
+/*
+ Sorts what was queued by layer, texture and color, draws it and stops queueing.
+ */
+void render_submit(State* state);
+
+/*
+ Stops queueing for a while, for drawing into a texture of its own in the middle of a frame.
+ Returns: Whether it was queueing, to pass to render_resume().
+ */
+bool render_pause(State* state);
+
+void render_resume(State* state, bool queueing);
+
+void render_sprite(State* state, TexID texture_id, const SDL_Rect* source_rect,
+    const SDL_Rect* dest_rect, SDL_Color color);
+
+void render_fill(State* state, const SDL_Rect* dest_rect, SDL_Color color);
+
+/*
+ Queues a copy of a whole texture. texture_id is TEXTURE_UNKNOWN for textures that don't have one.
+ A dest_rect of NULL covers the whole view.
+ */
+void render_copy(State* state, TexID texture_id, SDL_Texture* texture, const SDL_Rect* dest_rect);
+
+/*
+ Counts a draw call in the stats of the frame. texture is NULL for draws without one.
+ */
+void render_count_draw(State* state, SDL_Texture* texture);
+
+/*
+ Returns: What drawing the last frame took.
+ */
+const RenderStats* render_stats(State* state);
+
+/*
+ Sorts keys by their key, keeping the order of equal ones. scratch needs room for count keys.
+ */
+void render_sort(RenderKey* keys, RenderKey* scratch, uint32_t count);
@@ -0,0 +1,311 @@
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "draw.h"
+#include "board.h"
+#include "interact.h"
+#include "hint.h"
+#include "doom.h"
+#include "ai.h"
+#include "route.h"
+
+#if TILES_ACROSS * TILES_DOWN > 64
+#error "Board is too big for Bitboard."
+#endif
+
+#define BOARD_BITS (TILE_COUNT == 64 ? ~(Bitboard)0 : (((Bitboard)1 << TILE_COUNT) - 1))
+#define ROUTE_UNREACHABLE UINT8_MAX
+#define ROUTE_MAX_CHOICES 64
+#define ROUTE_MAX_NODES 500 /* Positions searched before giving up, which bounds the time taken. */
+
+/*
+ Distances are found with a breadth-first search over bitboards of the open tiles, which grows a
+ whole layer of tiles per step with a few shifts. That's cheap enough to redo after every move that
+ the plan tries, so the other pieces' turns are filled in by trying each of their moves and keeping
+ the subject closest to the target, without searching over every combination of them.
+ */
+
+static const Coord dir_dx[] = {0, 1, 0, -1};
+static const Coord dir_dy[] = {-1, 0, 1, 0};
+
+static Bitboard column_bits(Coord x) {
+    Bitboard result = 0;
+    for (Coord y = 0; y < TILES_DOWN; y += 1) {
+        result |= (Bitboard)1 << (y * TILES_ACROSS + x);
+    }
+    return result;
+}
+
+static Bitboard tile_bit(Coord x, Coord y) {
+    return (Bitboard)1 << (y * TILES_ACROSS + x);
+}
+
+/*
+ layers: If not NULL, layers[d] is set to the tiles d steps away from from.
+ Returns: The number of steps from from to to over open tiles, or ROUTE_UNREACHABLE.
+ */
+static uint8_t route_layers(Bitboard open, Bitboard from, Bitboard to, Bitboard* layers) {
+    Bitboard not_left = BOARD_BITS & ~column_bits(0);
+    Bitboard not_right = BOARD_BITS & ~column_bits(TILE_RIGHT);
+
+    Bitboard seen = from;
+    Bitboard frontier = from;
+    uint8_t distance = 0;
+    while (true) {
+        if (layers != NULL) {
+            layers[distance] = frontier;
+        }
+        if ((frontier & to) != 0) {
+            return distance;
+        }
+
+        frontier = ((frontier << 1) & not_left) | ((frontier >> 1) & not_right)
+            | (frontier << TILES_ACROSS) | (frontier >> TILES_ACROSS);
+        frontier &= open & ~seen;
+        if (frontier == 0) {
+            return ROUTE_UNREACHABLE;
+        }
+        seen |= frontier;
+        distance += 1;
+    }
+}
+
+/*
+ Searches from the target so that layers[d - 1] holds the next steps of the subject.
+ Returns: The number of steps the subject is from the target, or ROUTE_UNREACHABLE.
+ */
+static uint8_t route_distance(Route* route, Components* comps, Bitboard* layers) {
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], route->subject);
+    if (position == NULL) {
+        return ROUTE_UNREACHABLE;
+    }
+    Bitboard from = tile_bit(route->target_x, route->target_y);
+    Bitboard to = tile_bit(position->x, position->y);
+    Bitboard open = (BOARD_BITS & ~type_bits(comps, COMPTYPE_OBSTRUCTION)) | from | to;
+    return route_layers(open, from, to, layers);
+}
+
+typedef struct {
+    Move move;
+    uint8_t distance; /* From the subject to the target after the move. */
+} RouteChoice;
+
+static void choice_insert(RouteChoice* choices, uint8_t* nchoices, Move move, uint8_t distance) {
+    uint8_t r = *nchoices;
+    while (r > 0 && choices[r - 1].distance > distance) {
+        choices[r] = choices[r - 1];
+        r -= 1;
+    }
+    choices[r] = (RouteChoice){move, distance};
+    *nchoices += 1;
+}
+
+/*
+ Lists the moves worth trying from comps. Steps of the subject along a shortest way come first,
+ then the other pieces' moves that still leave the subject a way to the target, closest first.
+ Returns: The number of choices.
+ */
+static uint8_t route_choices(Route* route, Components* comps, RouteChoice* choices) {
+    uint8_t nchoices = 0;
+    Bitboard layers[TILE_COUNT];
+    uint8_t distance = route_distance(route, comps, layers);
+    bool ready = !cooldown_active(comps, route->subject);
+
+    CompGroup* groups[] = {
+        &comps->compgroups[COMPTYPE_SELECTABLE],
+        &comps->compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        Entity entity = position->entity;
+        if (cooldown_active(comps, entity)) {
+            continue;
+        }
+
+        for (uint8_t dir = 0; dir < 4 && nchoices < ROUTE_MAX_CHOICES; dir += 1) {
+            Coord x = position->x + dir_dx[dir];
+            Coord y = position->y + dir_dy[dir];
+            if (!components_will_move(comps, entity, x, y)) {
+                continue;
+            }
+
+            if (entity == route->subject) {
+                bool closer = ready && distance != ROUTE_UNREACHABLE
+                    && (layers[distance - 1] & tile_bit(x, y)) != 0;
+                if (closer) {
+                    choice_insert(choices, &nchoices, (Move){entity, x, y}, 0);
+                }
+                continue;
+            }
+
+            if (components_copy(&route->trial, comps) != 0) {
+                ERROR("components_copy");
+                return nchoices;
+            }
+            if (components_command_move(&route->trial, entity, x, y) != OutcomeMoved) {
+                continue;
+            }
+            uint8_t after = route_distance(route, &route->trial, NULL);
+            if (after != ROUTE_UNREACHABLE) {
+                choice_insert(choices, &nchoices, (Move){entity, x, y}, after + 1);
+            }
+        }
+    }
+    return nchoices;
+}
+
+/* Puts route->scratch back to the position after the first depth moves of the route. */
+static int route_rewind(Route* route, Components* comps, uint16_t depth) {
+    if (components_copy(&route->scratch, comps) != 0) {
+        ERROR("components_copy");
+        return 1;
+    }
+    for (uint16_t r = 0; r < depth; r += 1) {
+        Move* move = &route->moves[r];
+        components_command_move(&route->scratch, move->subject, move->x, move->y);
+    }
+    return 0;
+}
+
+/*
+ Depth first from route->scratch, which holds the position after depth moves. The order of the
+ choices makes the first path it finds the greedy one, and it only backs up when the greedy choice
+ leads to a dead end, such as a dragon that can't move without eating.
+ */
+static bool route_search(Route* route, Components* comps, uint16_t depth) {
+    Components* scratch = &route->scratch;
+    CPosition* position = component_of(&scratch->compgroups[COMPTYPE_POSITION], route->subject);
+    if (position == NULL) {
+        return false;
+    }
+    if (position->x == route->target_x && position->y == route->target_y) {
+        route->nmoves = depth;
+        return true;
+    }
+    if (depth >= ROUTE_MAX_MOVES || route->budget == 0) {
+        return false;
+    }
+    route->budget -= 1;
+
+    RouteChoice choices[ROUTE_MAX_CHOICES];
+    uint8_t nchoices = route_choices(route, scratch, choices);
+    for (uint8_t r = 0; r < nchoices; r += 1) {
+        Move move = choices[r].move;
+        if (r > 0 && route_rewind(route, comps, depth) != 0) {
+            return false;
+        }
+        /* A move that ends the game can't be followed by any more moves. */
+        if (components_command_move(scratch, move.subject, move.x, move.y) != OutcomeMoved) {
+            continue;
+        }
+        route->moves[depth] = move;
+        if (route_search(route, comps, depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int route_plan(Route* route, Components* comps) {
+    route->nmoves = 0;
+    route->path = 0;
+    route->budget = ROUTE_MAX_NODES;
+
+    /* No point searching when the terrain alone is in the way. */
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], route->subject);
+    if (position == NULL) {
+        return 1;
+    }
+    Bitboard from = tile_bit(position->x, position->y);
+    Bitboard to = tile_bit(route->target_x, route->target_y);
+    Bitboard open = (BOARD_BITS & ~terrain_bits(comps)) | from | to;
+    if (route_layers(open, from, to, NULL) == ROUTE_UNREACHABLE) {
+        return 1;
+    }
+
+    if (route_rewind(route, comps, 0) != 0 || !route_search(route, comps, 0)) {
+        return 1;
+    }
+
+    route->path = from;
+    for (uint16_t r = 0; r < route->nmoves; r += 1) {
+        if (route->moves[r].subject == route->subject) {
+            route->path |= tile_bit(route->moves[r].x, route->moves[r].y);
+        }
+    }
+    return 0;
+}
+
+int route_init(State* state) {
+    Route* route = &state->route;
+    route->scratch = components_new();
+    route->trial = components_new();
+    return 0;
+}
+
+void route_end(State* state) {
+    components_free(&state->route.scratch);
+    components_free(&state->route.trial);
+}
+
+void route_set(State* state, Entity subject, Coord tile_x, Coord tile_y) {
+    Route* route = &state->route;
+    route->subject = subject;
+    route->target_x = tile_x;
+    route->target_y = tile_y;
+    route_refresh(state);
+}
+
+void route_clear(State* state) {
+    Route* route = &state->route;
+    if (route->subject != 0) {
+        route->subject = 0;
+        route->nmoves = 0;
+        route->path = 0;
+        redraw(state);
+    }
+}
+
+void route_refresh(State* state) {
+    Route* route = &state->route;
+    if (route->subject == 0) {
+        return;
+    }
+    if (state->game_over) {
+        route_clear(state);
+        return;
+    }
+
+    uint32_t start = SDL_GetTicks();
+    if (route_plan(route, &state->components) != 0) {
+        INFO("No route to x=%d y=%d.", route->target_x, route->target_y);
+        route_clear(state);
+        return;
+    }
+    if (route->nmoves == 0) {
+        route_clear(state);
+        return;
+    }
+    INFO("Route takes %u moves. Planned in %ums.", route->nmoves, SDL_GetTicks() - start);
+    redraw(state);
+}
+
+void route_step(State* state) {
+    Route* route = &state->route;
+    if (route->subject == 0 || route->nmoves == 0 || state->game_over) {
+        return;
+    }
+
+    Move move = route->moves[0];
+    if (ai_controls(state, move.subject)) {
+        return;
+    }
+    if (command_move(state, move.subject, move.x, move.y) != OutcomeInvalid) {
+        hint_cancel(state);
+        doom_check(state);
+        route_refresh(state);
+    }
+}
@@ -0,0 +1,30 @@
+
+int route_init(State* state);
+
+void route_end(State* state);
+
+/*
+ Plans and shows the moves that take subject to the tile, if there are any.
+ */
+void route_set(State* state, Entity subject, Coord tile_x, Coord tile_y);
+
+void route_clear(State* state);
+
+/*
+ Plans the route again from the current position. Call whenever the board changes. The route is
+ cleared once the subject gets there or when it can no longer get there.
+ */
+void route_refresh(State* state);
+
+/*
+ Plays the next move of the route unless it's the AI's to make.
+ */
+void route_step(State* state);
+
+/*
+ Finds moves from comps that take route->subject to the target tile. The subject steps along a
+ shortest way whenever it can. Otherwise one of the other pieces makes the move that keeps the
+ subject closest to the target and doesn't lead to a dead end.
+ Returns: 0 if successful
+ */
+int route_plan(Route* route, Components* comps);
@@ -6,6 +6,12 @@
 #include "draw.h"
 #include "interact.h"
 #include "board.h"
+#include "hint.h"
+#include "doom.h"
+#include "ai.h"
+#include "route.h"
+#include "preview.h"
+#include "render.h"
 
 RGBA color_move_valid = {40, 130, 100, 130};
 RGBA color_move_invalid = {150, 70, 60, 150};
@@ -16,6 +22,12 @@ RGBA color_select_valid = {40, 130, 100, 130};
 RGBA color_select_empty = {35, 40, 35, 105};
 RGBA color_select_invalid = {150, 70, 60, 150};
 
+RGBA color_hint_from = {210, 180, 40, 110};
+RGBA color_hint_to = {240, 220, 90, 150};
+
+RGBA color_route = {60, 110, 170, 90};
+RGBA color_route_next = {90, 150, 220, 140};
+
 static void tile_rect_draw(State* state, Coord tile_x, Coord tile_y) {
     SDL_Rect rect = {
         .x = tile_x * TILE_SIZE,
@@ -24,9 +36,7 @@ static void tile_rect_draw(State* state, Coord tile_x, Coord tile_y) {
         .h = TILE_SIZE,
     };
 
-    if (SDL_RenderFillRect(state->renderer, &rect) != 0) {
-        WARN("SDL_RenderFillRect");
-    }
+    draw_fill_rect(state, &rect);
 }
 
 void select_draw(State* state) {
@@ -73,6 +83,30 @@ void select_draw(State* state) {
         draw_set_color(state, color);
         tile_rect_draw(state, sel->hover_x, sel->hover_y);
     }
+
+    Route* route = &state->route;
+    if (route->subject != 0 && route->nmoves > 0) {
+        render_layer(state, LAYER_ROUTE);
+        draw_set_color(state, color_route);
+        for (Coord y = 0; y < TILES_DOWN; y += 1) {
+            for (Coord x = 0; x < TILES_ACROSS; x += 1) {
+                if ((route->path & ((Bitboard)1 << (y * TILES_ACROSS + x))) != 0) {
+                    tile_rect_draw(state, x, y);
+                }
+            }
+        }
+        render_layer(state, LAYER_ROUTE_NEXT);
+        draw_set_color(state, color_route_next);
+        tile_rect_draw(state, route->moves[0].x, route->moves[0].y);
+    }
+
+    if (state->hint.visible) {
+        render_layer(state, LAYER_HINT);
+        draw_set_color(state, color_hint_from);
+        tile_rect_draw(state, state->hint.from_x, state->hint.from_y);
+        draw_set_color(state, color_hint_to);
+        tile_rect_draw(state, state->hint.move.x, state->hint.move.y);
+    }
 }
 
 static bool in_view(int32_t x, int32_t y) {
@@ -90,10 +124,10 @@ static void update_validity(State* state, int32_t x, int32_t y) {
     
     if (sel->subject == 0) {
         /* No piece selected. */
-        Entity target = type_at(state, COMPTYPE_SELECTABLE, tdest_x, tdest_y);
+        Entity target = type_at(&state->components, COMPTYPE_SELECTABLE, tdest_x, tdest_y);
         if (target == 0) {
             /* No selectable piece. */
-            Entity av = type_at(state, COMPTYPE_AVATAR, tdest_x, tdest_y);
+            Entity av = type_at(&state->components, COMPTYPE_AVATAR, tdest_x, tdest_y);
             if (av == 0) {
                 /* No mobile/avatar piece; only terrain. */
                 sel->hover_status = HoverEmpty;
@@ -102,9 +136,8 @@ static void update_validity(State* state, int32_t x, int32_t y) {
                 sel->hover_status = HoverInvalid;
             }
         } else {
-            bool is_cd =
-                (component_of(&state->components.compgroups[COMPTYPE_COOLDOWN], target) != NULL);
-            if (is_cd) {
+            bool is_cd = cooldown_active(&state->components, target);
+            if (is_cd || ai_controls(state, target)) {
                 sel->hover_status = HoverInvalid;
             } else {
                 sel->hover_status = HoverValid;
@@ -141,11 +174,10 @@ void select_mouse_press(State* state, uint8_t button, int32_t x, int32_t y) {
     Selection* sel = &state->selection;
 
     if (sel->select_x < 0 || sel->select_y < 0) {
-        Entity subject = type_at(state, COMPTYPE_SELECTABLE, tile_x, tile_y);
+        Entity subject = type_at(&state->components, COMPTYPE_SELECTABLE, tile_x, tile_y);
         if (subject != 0) {
-            bool is_cd =
-                (component_of(&state->components.compgroups[COMPTYPE_COOLDOWN], subject) != NULL);
-            if (!is_cd) {
+            bool is_cd = cooldown_active(&state->components, subject);
+            if (!is_cd && !ai_controls(state, subject)) {
                 sel->select_x = tile_x;
                 sel->select_y = tile_y;
                 sel->subject = subject;
@@ -153,7 +185,14 @@ void select_mouse_press(State* state, uint8_t button, int32_t x, int32_t y) {
         }
     } else {
         if (sel->subject != 0) {
-            command_move(state, sel->subject, tile_x, tile_y);
+            if (command_move(state, sel->subject, tile_x, tile_y) != OutcomeInvalid) {
+                hint_cancel(state);
+                doom_check(state);
+                route_refresh(state);
+            } else if (abs(tile_x - sel->select_x) + abs(tile_y - sel->select_y) > 1) {
+                /* Too far to move to in one go. */
+                route_set(state, sel->subject, tile_x, tile_y);
+            }
         }
         
         sel->select_x = -1;
@@ -163,12 +202,34 @@ void select_mouse_press(State* state, uint8_t button, int32_t x, int32_t y) {
     update_validity(state, x, y);
 }
 
+/* The tiles that drawing the hover highlight and the preview touches. */
+static Bitboard hover_tiles(State* state) {
+    Selection* sel = &state->selection;
+    if (sel->hover_x < 0 || sel->hover_y < 0) {
+        return 0;
+    }
+    preview_update(state);
+    return state->preview.tiles | (Bitboard)1 << (sel->hover_y * TILES_ACROSS + sel->hover_x);
+}
+
+/* Marks what the hover highlight covered before and after a change for drawing. */
+static void hover_damage(State* state, Selection before, Bitboard before_tiles) {
+    Selection* sel = &state->selection;
+    if (sel->hover_x == before.hover_x && sel->hover_y == before.hover_y
+            && sel->hover_status == before.hover_status) {
+        return;
+    }
+    draw_damage_tiles(state, before_tiles | hover_tiles(state));
+}
+
 void select_mouse_move(State* state, int32_t x, int32_t y) {
     if (state->game_over) {
         return;
     }
     
     Selection* sel = &state->selection;
+    Selection before = *sel;
+    Bitboard before_tiles = hover_tiles(state);
     
     if (in_view(x, y)) {
         sel->hover_x = x / TILE_SIZE;
@@ -179,6 +240,7 @@ void select_mouse_move(State* state, int32_t x, int32_t y) {
         sel->hover_x = -1;
         sel->hover_y = -1;
     }
+    hover_damage(state, before, before_tiles);
 }
 
 void select_mouse_leave(State* state) {
@@ -187,6 +249,9 @@ void select_mouse_leave(State* state) {
     }
     
     Selection* sel = &state->selection;
+    Selection before = *sel;
+    Bitboard before_tiles = hover_tiles(state);
     sel->hover_x = -1;
     sel->hover_y = -1;
+    hover_damage(state, before, before_tiles);
 }
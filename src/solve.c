@@ -0,0 +1,527 @@
+#include <stdio.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "board.h"
+#include "interact.h"
+#include "solve.h"
+#include "disk.h"
+
+#if TILES_ACROSS * TILES_DOWN >= SOLVE_TILE_NONE
+#error "Board is too big for the tile bits of BoardKey."
+#endif
+
+#define NODE_ROOT UINT32_MAX
+
+static const Coord dir_dx[SOLVE_DIRS] = {0, 1, 0, -1};
+static const Coord dir_dy[SOLVE_DIRS] = {-1, 0, 1, 0};
+
+/* Works out which mirror images of the terrain are the same as the terrain itself. */
+static void solver_symmetries_init(Solver* solver, Components* comps) {
+    for (uint8_t t = 0; t < SOLVE_TRANSFORMS; t += 1) {
+        for (Coord y = 0; y < TILES_DOWN; y += 1) {
+            for (Coord x = 0; x < TILES_ACROSS; x += 1) {
+                Coord tx = (t & SOLVE_FLIP_X) != 0 ? TILE_RIGHT - x : x;
+                Coord ty = (t & SOLVE_FLIP_Y) != 0 ? TILE_BOTTOM - y : y;
+                solver->transformed_tiles[t][y * TILES_ACROSS + x] = ty * TILES_ACROSS + tx;
+            }
+        }
+    }
+
+    Bitboard walls = terrain_bits(comps);
+    solver->symmetries = 1;
+    for (uint8_t t = 1; t < SOLVE_TRANSFORMS; t += 1) {
+        Bitboard transformed = 0;
+        for (uint8_t r = 0; r < TILES_ACROSS * TILES_DOWN; r += 1) {
+            if ((walls & ((Bitboard)1 << r)) != 0) {
+                transformed |= (Bitboard)1 << solver->transformed_tiles[t][r];
+            }
+        }
+        if (transformed == walls) {
+            solver->symmetries |= 1 << t;
+        }
+    }
+}
+
+int solver_init(Solver* solver, Components* comps) {
+    solver_symmetries_init(solver, comps);
+    solver->initial = components_new();
+    solver->scratch = components_new();
+    solver->next = components_new();
+    solver->npieces = 0;
+    if (components_copy(&solver->initial, comps) != 0) {
+        ERROR("components_copy");
+        return 1;
+    }
+
+    CompGroup* avatars = &comps->compgroups[COMPTYPE_AVATAR];
+    for (uint32_t r = 0; r < avatars->alive; r += 1) {
+        if (solver->npieces >= SOLVE_MAX_PIECES) {
+            WARN("Too many pieces to solve.");
+            return 1;
+        }
+        solver->pieces[solver->npieces] = ((CAvatar*)avatars->mem)[r].entity;
+        solver->npieces += 1;
+    }
+    return 0;
+}
+
+void solver_end(Solver* solver) {
+    components_free(&solver->initial);
+    components_free(&solver->scratch);
+    components_free(&solver->next);
+}
+
+BoardKey solver_key(Solver* solver, Components* comps) {
+    BoardKey key;
+    memset(&key, 0, sizeof(key));
+
+    for (uint8_t r = 0; r < solver->npieces; r += 1) {
+        Entity entity = solver->pieces[r];
+        CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], entity);
+        if (position == NULL) {
+            key.cells[r] = SOLVE_TILE_NONE;
+            continue;
+        }
+
+        uint8_t cell = position->y * TILES_ACROSS + position->x;
+        if (cooldown_active(comps, entity)) {
+            cell |= SOLVE_COOLDOWN_BIT;
+        }
+        if (component_of(&comps->compgroups[COMPTYPE_SLAYER], entity) != NULL) {
+            cell |= SOLVE_SLAYER_BIT;
+        }
+        key.cells[r] = cell;
+    }
+    return key;
+}
+
+int solver_load(Solver* solver, Components* dest, const BoardKey* key) {
+    if (components_copy(dest, &solver->initial) != 0) {
+        ERROR("components_copy");
+        return 1;
+    }
+    cooldown_reset(dest);
+
+    for (uint8_t r = 0; r < solver->npieces; r += 1) {
+        Entity entity = solver->pieces[r];
+        uint8_t cell = key->cells[r];
+        uint8_t tile = cell & SOLVE_TILE_MASK;
+        if (tile == SOLVE_TILE_NONE) {
+            components_entity_end(dest, entity);
+            continue;
+        }
+
+        CPosition* position = component_of(&dest->compgroups[COMPTYPE_POSITION], entity);
+        CAvatar* avatar = component_of(&dest->compgroups[COMPTYPE_AVATAR], entity);
+        if (position == NULL || avatar == NULL) {
+            ERROR("Piece is missing components.");
+            return 1;
+        }
+        position_set(dest, position, tile % TILES_ACROSS, tile / TILES_ACROSS);
+        avatar->x = position->x;
+        avatar->y = position->y;
+
+        if ((cell & SOLVE_COOLDOWN_BIT) != 0) {
+            cooldown_start(dest, entity);
+        }
+        if ((cell & SOLVE_SLAYER_BIT) != 0
+                && component_of(&dest->compgroups[COMPTYPE_SLAYER], entity) == NULL) {
+            /* Same transformation as mounting up in interact(). */
+            component_end(&dest->compgroups[COMPTYPE_RIDER], entity);
+            slayer_init(dest, entity);
+            avatar->icon_id = ICON_MKNIGHT;
+        }
+    }
+    return 0;
+}
+
+Move solver_move(Solver* solver, Components* comps, uint8_t code) {
+    Move move = {0, 0, 0};
+    uint8_t piece = code / SOLVE_DIRS;
+    uint8_t dir = code % SOLVE_DIRS;
+    if (piece >= solver->npieces) {
+        return move;
+    }
+
+    move.subject = solver->pieces[piece];
+    CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], move.subject);
+    if (position != NULL) {
+        move.x = position->x + dir_dx[dir];
+        move.y = position->y + dir_dy[dir];
+    }
+    return move;
+}
+
+uint8_t solver_moves(Solver* solver, Components* comps, uint8_t* moves) {
+    uint8_t count = 0;
+    for (uint8_t r = 0; r < solver->npieces; r += 1) {
+        Entity entity = solver->pieces[r];
+        if (component_of(&comps->compgroups[COMPTYPE_SELECTABLE], entity) == NULL) {
+            continue;
+        }
+        if (cooldown_active(comps, entity)) {
+            continue;
+        }
+
+        for (uint8_t dir = 0; dir < SOLVE_DIRS; dir += 1) {
+            uint8_t code = r * SOLVE_DIRS + dir;
+            Move move = solver_move(solver, comps, code);
+            if (components_will_move(comps, move.subject, move.x, move.y)) {
+                moves[count] = code;
+                count += 1;
+            }
+        }
+    }
+    return count;
+}
+
+BoardKey solver_transform(Solver* solver, const BoardKey* key, uint8_t transform) {
+    BoardKey result = *key;
+    for (uint8_t r = 0; r < solver->npieces; r += 1) {
+        uint8_t tile = key->cells[r] & SOLVE_TILE_MASK;
+        if (tile != SOLVE_TILE_NONE) {
+            result.cells[r] = (key->cells[r] & ~SOLVE_TILE_MASK)
+                | solver->transformed_tiles[transform][tile];
+        }
+    }
+    return result;
+}
+
+BoardKey solver_canonical(Solver* solver, const BoardKey* key, uint8_t* transform) {
+    *transform = 0;
+    if (solver->symmetries == 1) {
+        return *key;
+    }
+
+    /* The board has even sides so no tile is its own mirror image. That makes the first piece on
+       the board enough to pick the transform, without comparing whole keys. */
+    for (uint8_t r = 0; r < solver->npieces; r += 1) {
+        uint8_t tile = key->cells[r] & SOLVE_TILE_MASK;
+        if (tile == SOLVE_TILE_NONE) {
+            continue;
+        }
+
+        uint8_t best = tile;
+        for (uint8_t t = 1; t < SOLVE_TRANSFORMS; t += 1) {
+            if ((solver->symmetries & (1 << t)) != 0 && solver->transformed_tiles[t][tile] < best) {
+                best = solver->transformed_tiles[t][tile];
+                *transform = t; /* Every transform undoes itself. */
+            }
+        }
+        break;
+    }
+    if (*transform == 0) {
+        return *key;
+    }
+    return solver_transform(solver, key, *transform);
+}
+
+uint64_t solver_key_hash(const BoardKey* key) {
+    uint64_t a, b;
+    memcpy(&a, key->cells, sizeof(a));
+    memcpy(&b, key->cells + sizeof(a), sizeof(b));
+
+    uint64_t h = (a ^ (b * 0x9E3779B97F4A7C15ull)) * 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Visited set. Nodes are stored in the order they're found so the array doubles as the queue. */
+
+typedef struct {
+    BoardKey key; /* Canonical, so mirror images share a node. */
+    uint32_t parent;
+    uint8_t move; /* Played from the parent's actual position. */
+    uint8_t transform; /* Turns key into the actual position that move led to. */
+} SearchNode;
+
+typedef struct {
+    SearchNode* nodes;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* slots; /* Node index + 1, or 0 for an empty slot. */
+    uint32_t mask;
+} NodeTable;
+
+static int table_init(NodeTable* table) {
+    table->count = 0;
+    table->capacity = 1024;
+    table->mask = 2047;
+    table->nodes = malloc(table->capacity * sizeof(SearchNode));
+    table->slots = calloc(table->mask + 1, sizeof(uint32_t));
+    if (table->nodes == NULL || table->slots == NULL) {
+        ERROR("Out of memory.");
+        return 1;
+    }
+    return 0;
+}
+
+static void table_end(NodeTable* table) {
+    free(table->nodes);
+    free(table->slots);
+    table->nodes = NULL;
+    table->slots = NULL;
+}
+
+static int table_grow(NodeTable* table) {
+    uint32_t capacity = table->capacity * 2;
+    SearchNode* nodes = realloc(table->nodes, capacity * sizeof(SearchNode));
+    if (nodes == NULL) {
+        return 1;
+    }
+    table->nodes = nodes;
+    table->capacity = capacity;
+
+    /* Keep the slots at most half full. */
+    uint32_t mask = capacity * 2 - 1;
+    uint32_t* slots = calloc(mask + 1, sizeof(uint32_t));
+    if (slots == NULL) {
+        return 1;
+    }
+    for (uint32_t r = 0; r < table->count; r += 1) {
+        uint32_t slot = solver_key_hash(&nodes[r].key) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = r + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->mask = mask;
+    return 0;
+}
+
+/*
+ Returns: true if the key was added, false if it was already present or there's no memory left.
+ */
+static bool table_add(
+        NodeTable* table, const BoardKey* key, uint8_t transform, uint32_t parent, uint8_t move) {
+    if (table->count >= table->capacity && table_grow(table) != 0) {
+        ERROR("Out of memory.");
+        return false;
+    }
+
+    uint32_t slot = solver_key_hash(key) & table->mask;
+    while (table->slots[slot] != 0) {
+        SearchNode* other = &table->nodes[table->slots[slot] - 1];
+        if (memcmp(&other->key, key, sizeof(BoardKey)) == 0) {
+            return false;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    SearchNode* node = &table->nodes[table->count];
+    node->key = *key;
+    node->parent = parent;
+    node->move = move;
+    node->transform = transform;
+    table->count += 1;
+    table->slots[slot] = table->count;
+    return true;
+}
+
+bool solve_out_of_time(const SolveLimits* limits) {
+    if (limits->cancel != NULL && SDL_AtomicGet(limits->cancel) != 0) {
+        return true;
+    }
+    return limits->deadline != 0 && SDL_GetTicks() >= limits->deadline;
+}
+
+/* Walks the parent links back to the start to fill in the moves of the solution. */
+static int solution_init(
+        Solver* solver, NodeTable* table, uint32_t index, uint8_t last, SolveResult* result) {
+    uint8_t codes[SOLVE_MAX_LENGTH];
+    uint32_t parents[SOLVE_MAX_LENGTH];
+    uint16_t length = 0;
+
+    codes[length] = last;
+    parents[length] = index;
+    length += 1;
+    while (table->nodes[index].parent != NODE_ROOT) {
+        if (length >= SOLVE_MAX_LENGTH) {
+            ERROR("Solution too long.");
+            return 1;
+        }
+        codes[length] = table->nodes[index].move;
+        index = table->nodes[index].parent;
+        parents[length] = index;
+        length += 1;
+    }
+
+    result->length = length;
+    for (uint16_t r = 0; r < length; r += 1) {
+        SearchNode* node = &table->nodes[parents[length - 1 - r]];
+        BoardKey key = solver_transform(solver, &node->key, node->transform);
+        if (solver_load(solver, &solver->scratch, &key) != 0) {
+            return 1;
+        }
+        result->moves[r] = solver_move(solver, &solver->scratch, codes[length - 1 - r]);
+    }
+    return 0;
+}
+
+int solve(Components* comps, const SolveLimits* limits, SolveResult* result) {
+    memset(result, 0, sizeof(SolveResult));
+
+    uint16_t max_depth = limits->max_depth;
+    if (max_depth == 0 || max_depth > SOLVE_MAX_LENGTH) {
+        max_depth = SOLVE_MAX_LENGTH;
+    }
+
+    Solver solver;
+    NodeTable table = {NULL, 0, 0, NULL, 0};
+    if (solver_init(&solver, comps) != 0 || table_init(&table) != 0) {
+        table_end(&table);
+        solver_end(&solver);
+        return 1;
+    }
+
+    BoardKey start = solver_key(&solver, comps);
+    uint8_t transform;
+    BoardKey canonical = solver_canonical(&solver, &start, &transform);
+    table_add(&table, &canonical, transform, NODE_ROOT, 0);
+
+    int status = 0;
+    uint64_t legal_total = 0;
+    uint32_t layer_end = table.count;
+    uint16_t depth = 0;
+    bool stopped = false;
+
+    for (uint32_t index = 0; index < table.count; index += 1) {
+        if (index == layer_end) {
+            depth += 1;
+            layer_end = table.count;
+        }
+        if (depth >= max_depth) {
+            stopped = true;
+            break;
+        }
+        if ((index & 0xFF) == 0 && solve_out_of_time(limits)) {
+            stopped = true;
+            break;
+        }
+        if (limits->max_nodes != 0 && table.count >= limits->max_nodes) {
+            stopped = true;
+            break;
+        }
+
+        /* Copy the key because adding nodes can move the node array. */
+        BoardKey key = solver_transform(
+            &solver, &table.nodes[index].key, table.nodes[index].transform);
+        if (solver_load(&solver, &solver.scratch, &key) != 0) {
+            status = 1;
+            break;
+        }
+
+        uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+        uint8_t nmoves = solver_moves(&solver, &solver.scratch, moves);
+        legal_total += nmoves;
+        result->nodes += 1;
+
+        for (uint8_t r = 0; r < nmoves; r += 1) {
+            if (components_copy(&solver.next, &solver.scratch) != 0) {
+                status = 1;
+                break;
+            }
+            Move move = solver_move(&solver, &solver.next, moves[r]);
+            Outcome outcome = components_command_move(&solver.next, move.subject, move.x, move.y);
+            if (outcome == OutcomeWon) {
+                result->solved = true;
+                if (solution_init(&solver, &table, index, moves[r], result) != 0) {
+                    status = 1;
+                }
+                break;
+            }
+            if (outcome != OutcomeMoved) {
+                continue;
+            }
+
+            BoardKey next = solver_key(&solver, &solver.next);
+            canonical = solver_canonical(&solver, &next, &transform);
+            table_add(&table, &canonical, transform, index, moves[r]);
+        }
+        if (result->solved || status != 0) {
+            break;
+        }
+    }
+
+    result->exhausted = !result->solved && !stopped && status == 0;
+    if (result->nodes > 0) {
+        result->branching = (float_t)legal_total / (float_t)result->nodes;
+    }
+
+    table_end(&table);
+    solver_end(&solver);
+    return status;
+}
+
+int solve_main(int argc, char* argv[]) {
+    const char* dir = NULL;
+    if (argc >= 2 && strcmp(argv[0], "--disk") == 0) {
+        dir = argv[1];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 1) {
+        ERROR("Usage: solve [--disk DIR] FILE...");
+        return 1;
+    }
+
+    SolveLimits limits = {0, 0, 0, NULL};
+    SolveResult* result = malloc(sizeof(SolveResult));
+    Components comps = components_new();
+    if (result == NULL) {
+        ERROR("Out of memory.");
+        components_free(&comps);
+        return 1;
+    }
+
+    int status = 0;
+    for (int r = 0; r < argc; r += 1) {
+        char* pack = level_pack_load(argv[r]);
+        if (pack == NULL) {
+            status = 1;
+            continue;
+        }
+
+        const char* text = pack;
+        LevelID level_id = 0;
+        while (*level_skip(text) != '\0' && level_id < UINT8_MAX) {
+            level_id += 1;
+            components_clear(&comps);
+            if (level_parse(&comps, text, &text) != 0) {
+                WARN("%s level %d doesn't parse.", argv[r], level_id);
+                status = 1;
+                break;
+            }
+
+            uint32_t start = SDL_GetTicks();
+            int searched = dir != NULL
+                ? disk_solve(&comps, dir, &limits, result)
+                : solve(&comps, &limits, result);
+            if (searched != 0) {
+                printf("%s level %d: search failed\n", argv[r], level_id);
+                status = 1;
+                continue;
+            }
+            if (result->solved) {
+                printf("%s level %d: %u moves", argv[r], level_id, result->length);
+            } else {
+                printf("%s level %d: %s", argv[r], level_id,
+                    result->exhausted ? "unsolvable" : "no solution found");
+            }
+            printf(", %llu positions searched in %ums\n",
+                (unsigned long long)result->nodes, SDL_GetTicks() - start);
+        }
+        free(pack);
+    }
+
+    components_free(&comps);
+    free(result);
+    return status;
+}
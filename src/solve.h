@@ -0,0 +1,106 @@
+
+#define SOLVE_MAX_PIECES 16
+#define SOLVE_MAX_LENGTH 128
+
+/* Layout of each BoardKey cell. */
+#define SOLVE_TILE_MASK 0x3F
+#define SOLVE_TILE_NONE 0x3F /* The piece has been removed from the board. */
+#define SOLVE_COOLDOWN_BIT 0x40
+#define SOLVE_SLAYER_BIT 0x80
+
+#define SOLVE_DIRS 4
+
+/* Transforms of the board, as bits that can be combined. Both together turn it halfway around. */
+#define SOLVE_FLIP_X 1
+#define SOLVE_FLIP_Y 2
+#define SOLVE_TRANSFORMS 4
+
+/*
+ Compact encoding of everything that can change during a level: one cell per piece holding its tile
+ index and the bits above. Terrain never changes so it's kept once in the Solver.
+ */
+typedef struct {
+    uint8_t cells[SOLVE_MAX_PIECES];
+} BoardKey;
+
+typedef struct {
+    Components initial;
+    Components scratch;
+    Components next;
+    Entity pieces[SOLVE_MAX_PIECES];
+    uint8_t npieces;
+    uint8_t symmetries; /* Bit t is set when transform t leaves the terrain the same. */
+    uint8_t transformed_tiles[SOLVE_TRANSFORMS][TILES_ACROSS * TILES_DOWN];
+} Solver;
+
+typedef struct {
+    uint64_t max_nodes; /* 0 = no limit */
+    uint16_t max_depth; /* 0 = SOLVE_MAX_LENGTH */
+    uint32_t deadline; /* SDL_GetTicks() value to give up at, or 0 for none */
+    SDL_atomic_t* cancel; /* Search stops when this becomes nonzero. May be NULL. */
+} SolveLimits;
+
+typedef struct {
+    bool solved;
+    bool exhausted; /* Every reachable position was searched so an unsolved level is impossible. */
+    uint16_t length;
+    uint64_t nodes;
+    float_t branching; /* Average number of legal moves per searched position. */
+    Move moves[SOLVE_MAX_LENGTH];
+} SolveResult;
+
+/*
+ Takes a copy of comps to solve from. Pieces are the entities that have an avatar.
+ Returns: 0 if successful
+ */
+int solver_init(Solver* solver, Components* comps);
+
+void solver_end(Solver* solver);
+
+BoardKey solver_key(Solver* solver, Components* comps);
+
+uint64_t solver_key_hash(const BoardKey* key);
+
+BoardKey solver_transform(Solver* solver, const BoardKey* key, uint8_t transform);
+
+/*
+ Positions that are mirror images of each other on symmetric terrain play out the same way, so
+ searches only need to visit one of them.
+ Returns: The same key for a position and all of its mirror images. Sets transform to the one that
+          turns the result back into key.
+ */
+BoardKey solver_canonical(Solver* solver, const BoardKey* key, uint8_t* transform);
+
+/*
+ Rebuilds the components described by key into dest.
+ Returns: 0 if successful
+ */
+int solver_load(Solver* solver, Components* dest, const BoardKey* key);
+
+/*
+ Move codes are piece index * SOLVE_DIRS + direction.
+ Returns: The number of legal move codes written to moves, which must hold
+          SOLVE_MAX_PIECES * SOLVE_DIRS codes.
+ */
+uint8_t solver_moves(Solver* solver, Components* comps, uint8_t* moves);
+
+/*
+ Returns: The move that the move code stands for when played from comps.
+ */
+Move solver_move(Solver* solver, Components* comps, uint8_t code);
+
+/*
+ Returns: true if the search should stop because of the deadline or cancel flag in limits.
+ */
+bool solve_out_of_time(const SolveLimits* limits);
+
+/*
+ Breadth-first search for the shortest sequence of moves that wins the level in comps.
+ Returns: 0 if the search ran, even if it found no solution.
+ */
+int solve(Components* comps, const SolveLimits* limits, SolveResult* result);
+
+/*
+ Command line entry point: solve [--disk DIR] FILE...
+ */
+int solve_main(int argc, char* argv[]);
@@ -6,6 +6,15 @@
 #include "state.h"
 #include "audio.h"
 #include "draw.h"
+#include "hint.h"
+#include "ai.h"
+#include "route.h"
+#include "preview.h"
+#include "batch.h"
+#include "text.h"
+#include "atlas.h"
+#include "doom.h"
+#include "tablebase.h"
 
 State* state_new() {
     /* Using calloc to initialize to zero. */
@@ -20,6 +29,19 @@ State* state_new() {
     state->selection.select_x = -1;
     state->selection.select_y = -1;
     state->components = components_new();
+    batch_init(state);
+    if (hint_init(state) != 0) {
+        WARN("hint_init");
+    }
+    if (ai_init(state) != 0) {
+        WARN("ai_init");
+    }
+    if (route_init(state) != 0) {
+        WARN("route_init");
+    }
+    if (preview_init(state) != 0) {
+        WARN("preview_init");
+    }
     return state;
 }
 
@@ -28,6 +50,17 @@ void state_end(State* state) {
         return;
     }
 
+    hint_end(state);
+    ai_end(state);
+    route_end(state);
+    preview_end(state);
+    doom_end(&state->doom);
+    for (uint8_t r = 0; r < state->ntablebases; r += 1) {
+        tablebase_end(&state->tablebases[r]);
+    }
+
+    text_invalidate(state);
+    atlas_decode_free(&state->captions);
     for (int i = 0; i < TEXTURE_COUNT; i += 1) {
         if (state->textures[i] != NULL) {
             SDL_DestroyTexture(state->textures[i]);
@@ -44,6 +77,9 @@ void state_end(State* state) {
 
     draw_loading_done();
     
+    free(state->level_pack);
+    components_free(&state->components);
+    
     audio_done_blocking(state);
 
     free(state);
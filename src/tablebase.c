@@ -0,0 +1,774 @@
+/* For mmap(). */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SDL.h"
+#include "logging.h"
+#include "entity.h"
+#include "constants.h"
+#include "component.h"
+#include "board.h"
+#include "interact.h"
+#include "solve.h"
+#include "tablebase.h"
+
+/*
+ A tablebase file is a TablebaseHeader followed by one byte per index. Each piece in the roster
+ contributes a digit to the index: its place among the open tiles (or one past the last for a horse
+ that has been mounted) times two if it can be on cooldown, plus its cooldown bit. Whether the
+ knight is mounted follows from whether the horse is on the board so it takes no space. Indexes
+ that don't stand for a legal position hold TABLEBASE_NONE.
+
+ Files are written in the byte order of the machine that built them.
+ */
+
+#define TABLEBASE_MAGIC "DEMSTBL"
+#define TABLEBASE_VERSION 2
+#define TABLEBASE_MAX_ENTRIES ((uint64_t)1 << 25)
+#define TABLEBASE_MAX_LIVESTOCK 2
+#define TABLEBASE_MAX_THREADS 64
+#define TABLEBASE_NO_INDEX UINT64_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t entries;
+    Bitboard walls;
+    uint8_t npieces;
+    char roster[TABLEBASE_MAX_PIECES];
+    uint8_t nopen;
+    uint8_t reserved[24]; /* Pads the header to 64 bytes so the table starts aligned. */
+} TablebaseHeader;
+
+static const Coord dir_dx[SOLVE_DIRS] = {0, 1, 0, -1};
+static const Coord dir_dy[SOLVE_DIRS] = {-1, 0, 1, 0};
+
+static bool kind_selectable(char kind) {
+    return kind != LEVEL_CHAR_SHEEP;
+}
+
+static bool kind_removable(char kind) {
+    return kind == LEVEL_CHAR_HORSE;
+}
+
+static bool kind_livestock(char kind) {
+    return kind == LEVEL_CHAR_SHEEP || kind == LEVEL_CHAR_DOG;
+}
+
+/* A mounted knight takes the knight's slot when the roster has a horse that it got off of. */
+static char kind_of(Components* comps, Entity entity, bool has_horse) {
+    if (component_of(&comps->compgroups[COMPTYPE_SLAYME], entity) != NULL) {
+        return LEVEL_CHAR_DRAGON;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_RIDER], entity) != NULL) {
+        return LEVEL_CHAR_KNIGHT;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_SLAYER], entity) != NULL) {
+        return has_horse ? LEVEL_CHAR_KNIGHT : LEVEL_CHAR_MKNIGHT;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_MOUNT], entity) != NULL) {
+        return LEVEL_CHAR_HORSE;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_HERDER], entity) != NULL) {
+        return LEVEL_CHAR_DOG;
+    }
+    if (component_of(&comps->compgroups[COMPTYPE_FLOCK], entity) != NULL) {
+        return LEVEL_CHAR_SHEEP;
+    }
+    return 0;
+}
+
+static bool roster_has(const Tablebase* tb, char kind) {
+    return memchr(tb->roster, kind, tb->npieces) != NULL;
+}
+
+/*
+ Works out the open tiles and index strides for the terrain and pieces.
+ Returns: 0 if the table would be small enough and the roster is one that tables are made for.
+ */
+static int tablebase_layout(Tablebase* tb, Bitboard walls, const char* roster, uint8_t npieces) {
+    if (npieces > TABLEBASE_MAX_PIECES) {
+        WARN("Too many pieces for a tablebase.");
+        return 1;
+    }
+
+    uint8_t dragons = 0;
+    uint8_t knights = 0;
+    uint8_t horses = 0;
+    uint8_t livestock = 0;
+    for (uint8_t r = 0; r < npieces; r += 1) {
+        char kind = roster[r];
+        if (kind == LEVEL_CHAR_DRAGON) {
+            dragons += 1;
+        } else if (kind == LEVEL_CHAR_KNIGHT || kind == LEVEL_CHAR_MKNIGHT) {
+            knights += 1;
+        } else if (kind == LEVEL_CHAR_HORSE) {
+            horses += 1;
+        } else if (kind_livestock(kind)) {
+            livestock += 1;
+        } else {
+            WARN("Unknown piece '%c' in tablebase roster.", kind);
+            return 1;
+        }
+    }
+    bool horse_ok = horses == 0 || memchr(roster, LEVEL_CHAR_KNIGHT, npieces) != NULL;
+    if (dragons != 1 || knights != 1 || horses > 1 || !horse_ok
+            || livestock < 1 || livestock > TABLEBASE_MAX_LIVESTOCK) {
+        WARN("Tablebases need a dragon, a knight with or without a horse and 1-%d livestock.",
+            TABLEBASE_MAX_LIVESTOCK);
+        return 1;
+    }
+
+    tb->walls = walls;
+    tb->npieces = npieces;
+    memcpy(tb->roster, roster, npieces);
+
+    tb->nopen = 0;
+    for (uint8_t r = 0; r < TILES_ACROSS * TILES_DOWN; r += 1) {
+        tb->open_index[r] = 0xFF;
+        if ((walls & ((Bitboard)1 << r)) == 0) {
+            tb->open_index[r] = tb->nopen;
+            tb->open_tiles[tb->nopen] = r;
+            tb->nopen += 1;
+        }
+    }
+
+    uint64_t entries = 1;
+    for (uint8_t r = 0; r < npieces; r += 1) {
+        tb->strides[r] = entries;
+        uint64_t radix = tb->nopen + (kind_removable(roster[r]) ? 1 : 0);
+        if (kind_selectable(roster[r])) {
+            radix *= 2;
+        }
+        entries *= radix;
+        if (entries > TABLEBASE_MAX_ENTRIES) {
+            WARN("Too many positions for a tablebase.");
+            return 1;
+        }
+    }
+    tb->entries = entries;
+    return 0;
+}
+
+/*
+ Returns: The index of the position, or TABLEBASE_NO_INDEX if it isn't a legal position.
+ */
+static uint64_t key_index(const Tablebase* tb, const BoardKey* key) {
+    bool horse_removed = false;
+    for (uint8_t r = 0; r < tb->npieces; r += 1) {
+        if (tb->roster[r] == LEVEL_CHAR_HORSE) {
+            horse_removed = (key->cells[r] & SOLVE_TILE_MASK) == SOLVE_TILE_NONE;
+        }
+    }
+
+    uint64_t index = 0;
+    Bitboard taken = 0;
+    uint8_t selectable = 0;
+    uint8_t cooling = 0;
+    for (uint8_t r = 0; r < tb->npieces; r += 1) {
+        char kind = tb->roster[r];
+        uint8_t cell = key->cells[r];
+        uint8_t tile = cell & SOLVE_TILE_MASK;
+        bool cooldown = (cell & SOLVE_COOLDOWN_BIT) != 0;
+        bool slayer = (cell & SOLVE_SLAYER_BIT) != 0;
+
+        bool wants_slayer = kind == LEVEL_CHAR_MKNIGHT
+            || (kind == LEVEL_CHAR_KNIGHT && horse_removed);
+        if (slayer != wants_slayer) {
+            return TABLEBASE_NO_INDEX;
+        }
+        if (cooldown && !kind_selectable(kind)) {
+            return TABLEBASE_NO_INDEX;
+        }
+
+        uint64_t digit;
+        if (tile == SOLVE_TILE_NONE) {
+            if (!kind_removable(kind) || cooldown) {
+                return TABLEBASE_NO_INDEX;
+            }
+            digit = tb->nopen;
+        } else {
+            Bitboard bit = (Bitboard)1 << tile;
+            if (tile >= TILES_ACROSS * TILES_DOWN || tb->open_index[tile] == 0xFF
+                    || (taken & bit) != 0) {
+                return TABLEBASE_NO_INDEX;
+            }
+            taken |= bit;
+            digit = tb->open_index[tile];
+            if (kind_selectable(kind)) {
+                selectable += 1;
+            }
+        }
+
+        if (kind_selectable(kind)) {
+            digit = digit * 2 + (cooldown ? 1 : 0);
+            cooling += cooldown ? 1 : 0;
+        }
+        index += digit * tb->strides[r];
+    }
+
+    /* Cooldowns are cleared as soon as the last piece moves. */
+    if (cooling >= selectable) {
+        return TABLEBASE_NO_INDEX;
+    }
+    return index;
+}
+
+/*
+ Returns: true if the index stands for a legal position, which is then written to key.
+ */
+static bool index_key(const Tablebase* tb, uint64_t index, BoardKey* key) {
+    memset(key, 0, sizeof(BoardKey));
+
+    bool horse_removed = false;
+    uint64_t rest = index;
+    for (uint8_t r = 0; r < tb->npieces; r += 1) {
+        char kind = tb->roster[r];
+        uint64_t radix = tb->nopen + (kind_removable(kind) ? 1 : 0);
+        uint8_t cell = 0;
+        if (kind_selectable(kind)) {
+            cell |= (rest % 2) != 0 ? SOLVE_COOLDOWN_BIT : 0;
+            rest /= 2;
+        }
+        uint64_t digit = rest % radix;
+        rest /= radix;
+
+        if (digit == tb->nopen) {
+            cell |= SOLVE_TILE_NONE;
+            horse_removed = true;
+        } else {
+            cell |= tb->open_tiles[digit];
+        }
+        key->cells[r] = cell;
+    }
+
+    for (uint8_t r = 0; r < tb->npieces; r += 1) {
+        char kind = tb->roster[r];
+        if (kind == LEVEL_CHAR_MKNIGHT || (kind == LEVEL_CHAR_KNIGHT && horse_removed)) {
+            key->cells[r] |= SOLVE_SLAYER_BIT;
+        }
+    }
+    return key_index(tb, key) == index;
+}
+
+/* Matches the pieces in comps to the roster, in entity order for pieces of the same kind. */
+static bool tablebase_key(const Tablebase* tb, Components* comps, BoardKey* key) {
+    if (terrain_bits(comps) != tb->walls) {
+        return false;
+    }
+
+    bool has_horse = roster_has(tb, LEVEL_CHAR_HORSE);
+    CompGroup* avatars = &comps->compgroups[COMPTYPE_AVATAR];
+    if (avatars->alive > tb->npieces) {
+        return false;
+    }
+    bool used[TABLEBASE_MAX_PIECES] = {false};
+
+    memset(key, 0, sizeof(BoardKey));
+    for (uint8_t r = 0; r < tb->npieces; r += 1) {
+        Entity entity = 0;
+        for (uint32_t a = 0; a < avatars->alive; a += 1) {
+            Entity candidate = ((CAvatar*)avatars->mem)[a].entity;
+            if (!used[a] && kind_of(comps, candidate, has_horse) == tb->roster[r]) {
+                used[a] = true;
+                entity = candidate;
+                break;
+            }
+        }
+
+        CPosition* position = NULL;
+        if (entity != 0) {
+            position = component_of(&comps->compgroups[COMPTYPE_POSITION], entity);
+        }
+        if (position == NULL) {
+            if (!kind_removable(tb->roster[r])) {
+                return false;
+            }
+            key->cells[r] = SOLVE_TILE_NONE;
+            continue;
+        }
+
+        uint8_t cell = position->y * TILES_ACROSS + position->x;
+        if (cooldown_active(comps, entity)) {
+            cell |= SOLVE_COOLDOWN_BIT;
+        }
+        if (component_of(&comps->compgroups[COMPTYPE_SLAYER], entity) != NULL) {
+            cell |= SOLVE_SLAYER_BIT;
+        }
+        key->cells[r] = cell;
+    }
+
+    for (uint32_t a = 0; a < avatars->alive; a += 1) {
+        if (!used[a]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int tablebase_load(Tablebase* tb, const char* path) {
+    memset(tb, 0, sizeof(Tablebase));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("Couldn't open %s.", path);
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TablebaseHeader)) {
+        ERROR("%s isn't a tablebase.", path);
+        close(fd);
+        return 1;
+    }
+    void* map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        ERROR("Couldn't map %s.", path);
+        return 1;
+    }
+    tb->map = map;
+    tb->map_size = (size_t)info.st_size;
+
+    const TablebaseHeader* header = (const TablebaseHeader*)map;
+    bool valid = memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == TABLEBASE_VERSION
+        && header->header_size == sizeof(TablebaseHeader)
+        && header->entries == tb->map_size - sizeof(TablebaseHeader);
+    if (!valid) {
+        ERROR("%s isn't a tablebase for this version.", path);
+        tablebase_end(tb);
+        return 1;
+    }
+
+    uint64_t entries = header->entries;
+    if (tablebase_layout(tb, header->walls, header->roster, header->npieces) != 0
+            || tb->entries != entries || tb->nopen != header->nopen) {
+        ERROR("%s has a bad layout.", path);
+        tablebase_end(tb);
+        return 1;
+    }
+    tb->values = (const uint8_t*)map + sizeof(TablebaseHeader);
+    return 0;
+}
+
+void tablebase_end(Tablebase* tb) {
+    if (tb->map != NULL) {
+        munmap(tb->map, tb->map_size);
+    }
+    memset(tb, 0, sizeof(Tablebase));
+}
+
+uint8_t tablebase_probe(const Tablebase* tb, Components* comps) {
+    if (tb->values == NULL) {
+        return TABLEBASE_NONE;
+    }
+    BoardKey key;
+    if (!tablebase_key(tb, comps, &key)) {
+        return TABLEBASE_NONE;
+    }
+    uint64_t index = key_index(tb, &key);
+    if (index == TABLEBASE_NO_INDEX) {
+        return TABLEBASE_NONE;
+    }
+    return tb->values[index];
+}
+
+uint8_t tablebases_probe(State* state, Components* comps) {
+    for (uint8_t r = 0; r < state->ntablebases; r += 1) {
+        uint8_t value = tablebase_probe(&state->tablebases[r], comps);
+        if (value != TABLEBASE_NONE) {
+            return value;
+        }
+    }
+    return TABLEBASE_NONE;
+}
+
+bool tablebases_best_move(State* state, Components* scratch, Move* move) {
+    Components* comps = &state->components;
+    uint8_t value = tablebases_probe(state, comps);
+    if (value == TABLEBASE_NONE || value == TABLEBASE_LOST) {
+        return false;
+    }
+
+    uint8_t best = TABLEBASE_NONE;
+    CompGroup* selectables = &comps->compgroups[COMPTYPE_SELECTABLE];
+    for (uint32_t r = 0; r < selectables->alive; r += 1) {
+        Entity subject = ((CSelectable*)selectables->mem)[r].entity;
+        if (cooldown_active(comps, subject)) {
+            continue;
+        }
+        CPosition* position = component_of(&comps->compgroups[COMPTYPE_POSITION], subject);
+        if (position == NULL) {
+            continue;
+        }
+
+        for (uint8_t dir = 0; dir < SOLVE_DIRS; dir += 1) {
+            Move candidate = {subject, position->x + dir_dx[dir], position->y + dir_dy[dir]};
+            if (!components_will_move(comps, subject, candidate.x, candidate.y)) {
+                continue;
+            }
+            if (components_copy(scratch, comps) != 0) {
+                ERROR("components_copy");
+                return false;
+            }
+
+            Outcome outcome = components_command_move(scratch, subject, candidate.x, candidate.y);
+            if (outcome == OutcomeWon) {
+                *move = candidate;
+                return true;
+            }
+            if (outcome != OutcomeMoved) {
+                continue;
+            }
+            uint8_t next = tablebases_probe(state, scratch);
+            if (next != TABLEBASE_NONE && next != TABLEBASE_LOST && next < best) {
+                best = next;
+                *move = candidate;
+            }
+        }
+    }
+    return best != TABLEBASE_NONE;
+}
+
+/* Building. Each thread works on its own range of indexes for the whole build. */
+
+typedef struct {
+    const Tablebase* tb;
+    Components* template;
+    uint8_t* values;
+    uint64_t start;
+    uint64_t end;
+    uint32_t* firsts; /* Offset of the first successor of each index in the range, plus the end. */
+    uint32_t* edges; /* Indexes of successors. */
+    uint32_t nedges;
+    uint32_t capacity;
+    uint8_t distance; /* Distance being filled in by the current pass. */
+    uint32_t changed;
+    int status;
+} BuildChunk;
+
+static int chunk_edge_add(BuildChunk* chunk, uint32_t index) {
+    if (chunk->nedges >= chunk->capacity) {
+        uint32_t capacity = chunk->capacity * 2;
+        uint32_t* edges = realloc(chunk->edges, capacity * sizeof(uint32_t));
+        if (edges == NULL) {
+            return 1;
+        }
+        chunk->edges = edges;
+        chunk->capacity = capacity;
+    }
+    chunk->edges[chunk->nedges] = index;
+    chunk->nedges += 1;
+    return 0;
+}
+
+/* Plays every move from every position in the range once and remembers where each one leads. */
+static int build_expand(void* data) {
+    BuildChunk* chunk = (BuildChunk*)data;
+    const Tablebase* tb = chunk->tb;
+
+    Solver solver;
+    if (solver_init(&solver, chunk->template) != 0) {
+        solver_end(&solver);
+        chunk->status = 1;
+        return 1;
+    }
+
+    for (uint64_t index = chunk->start; index < chunk->end; index += 1) {
+        chunk->firsts[index - chunk->start] = chunk->nedges;
+
+        BoardKey key;
+        if (!index_key(tb, index, &key)) {
+            chunk->values[index] = TABLEBASE_NONE;
+            continue;
+        }
+
+        /* Mirror images get copied from their canonical position at the end. */
+        uint8_t transform;
+        solver_canonical(&solver, &key, &transform);
+        if (transform != 0) {
+            continue;
+        }
+
+        if (solver_load(&solver, &solver.scratch, &key) != 0) {
+            chunk->status = 1;
+            break;
+        }
+
+        uint8_t moves[SOLVE_MAX_PIECES * SOLVE_DIRS];
+        uint8_t nmoves = solver_moves(&solver, &solver.scratch, moves);
+        for (uint8_t r = 0; r < nmoves; r += 1) {
+            if (components_copy(&solver.next, &solver.scratch) != 0) {
+                chunk->status = 1;
+                break;
+            }
+            Move move = solver_move(&solver, &solver.next, moves[r]);
+            Outcome outcome = components_command_move(&solver.next, move.subject, move.x, move.y);
+            if (outcome == OutcomeWon) {
+                /* Nothing is closer than this so the other moves don't matter. */
+                chunk->values[index] = 1;
+                chunk->nedges = chunk->firsts[index - chunk->start];
+                break;
+            }
+            if (outcome != OutcomeMoved) {
+                continue;
+            }
+
+            BoardKey next = solver_key(&solver, &solver.next);
+            BoardKey canonical = solver_canonical(&solver, &next, &transform);
+            uint64_t next_index = key_index(tb, &canonical);
+            if (next_index != TABLEBASE_NO_INDEX && chunk_edge_add(chunk, next_index) != 0) {
+                ERROR("Out of memory.");
+                chunk->status = 1;
+                break;
+            }
+        }
+        if (chunk->status != 0) {
+            break;
+        }
+    }
+    chunk->firsts[chunk->end - chunk->start] = chunk->nedges;
+
+    solver_end(&solver);
+    return chunk->status;
+}
+
+/*
+ Marks the positions one move away from the ones found by the previous pass. Other threads only
+ write the distance of this pass, which is never the one being looked for, so no locking is needed.
+ */
+static int build_pass(void* data) {
+    BuildChunk* chunk = (BuildChunk*)data;
+    uint8_t* values = chunk->values;
+    uint8_t previous = chunk->distance - 1;
+
+    chunk->changed = 0;
+    for (uint64_t index = chunk->start; index < chunk->end; index += 1) {
+        if (values[index] != TABLEBASE_LOST) {
+            continue;
+        }
+        uint32_t first = chunk->firsts[index - chunk->start];
+        uint32_t last = chunk->firsts[index - chunk->start + 1];
+        for (uint32_t r = first; r < last; r += 1) {
+            if (values[chunk->edges[r]] == previous) {
+                values[index] = chunk->distance;
+                chunk->changed += 1;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Copies the values of canonical positions to their mirror images. */
+static int build_mirror(void* data) {
+    BuildChunk* chunk = (BuildChunk*)data;
+    const Tablebase* tb = chunk->tb;
+
+    Solver solver;
+    if (solver_init(&solver, chunk->template) != 0) {
+        solver_end(&solver);
+        chunk->status = 1;
+        return 1;
+    }
+
+    for (uint64_t index = chunk->start; index < chunk->end && solver.symmetries != 1; index += 1) {
+        BoardKey key;
+        if (!index_key(tb, index, &key)) {
+            continue;
+        }
+        uint8_t transform;
+        BoardKey canonical = solver_canonical(&solver, &key, &transform);
+        if (transform != 0) {
+            chunk->values[index] = chunk->values[key_index(tb, &canonical)];
+        }
+    }
+
+    solver_end(&solver);
+    return 0;
+}
+
+static int build_run(BuildChunk* chunks, int32_t nchunks, SDL_ThreadFunction fn) {
+    SDL_Thread* threads[TABLEBASE_MAX_THREADS];
+    for (int32_t r = 0; r < nchunks; r += 1) {
+        threads[r] = SDL_CreateThread(fn, "tablebase", &chunks[r]);
+        if (threads[r] == NULL) {
+            /* Still gets done, just without the help. */
+            WARN("SDL_CreateThread");
+            fn(&chunks[r]);
+        }
+    }
+    int status = 0;
+    for (int32_t r = 0; r < nchunks; r += 1) {
+        if (threads[r] != NULL) {
+            SDL_WaitThread(threads[r], NULL);
+        }
+        status |= chunks[r].status;
+    }
+    return status;
+}
+
+static int tablebase_write(const Tablebase* tb, const uint8_t* values, const char* path) {
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLEBASE_MAGIC, sizeof(header.magic));
+    header.version = TABLEBASE_VERSION;
+    header.header_size = sizeof(TablebaseHeader);
+    header.entries = tb->entries;
+    header.walls = tb->walls;
+    header.npieces = tb->npieces;
+    memcpy(header.roster, tb->roster, tb->npieces);
+    header.nopen = tb->nopen;
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Couldn't create %s.", path);
+        return 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(values, 1, tb->entries, file) == tb->entries;
+    if (fclose(file) != 0 || !written) {
+        ERROR("Couldn't write %s.", path);
+        return 1;
+    }
+    return 0;
+}
+
+int tablebase_build(Components* comps, const char* path) {
+    uint32_t start_ticks = SDL_GetTicks();
+
+    Tablebase tb;
+    memset(&tb, 0, sizeof(tb));
+    char roster[TABLEBASE_MAX_PIECES];
+    CompGroup* avatars = &comps->compgroups[COMPTYPE_AVATAR];
+    if (avatars->alive > TABLEBASE_MAX_PIECES) {
+        WARN("Too many pieces for a tablebase.");
+        return 1;
+    }
+    bool has_horse = comps->compgroups[COMPTYPE_MOUNT].alive > 0;
+    for (uint32_t r = 0; r < avatars->alive; r += 1) {
+        roster[r] = kind_of(comps, ((CAvatar*)avatars->mem)[r].entity, has_horse);
+    }
+    if (tablebase_layout(&tb, terrain_bits(comps), roster, (uint8_t)avatars->alive) != 0) {
+        return 1;
+    }
+
+    uint8_t* values = calloc(tb.entries, 1);
+    if (values == NULL) {
+        ERROR("Out of memory.");
+        return 1;
+    }
+
+    int32_t nchunks = SDL_GetCPUCount();
+    if (nchunks < 1) {
+        nchunks = 1;
+    } else if (nchunks > TABLEBASE_MAX_THREADS) {
+        nchunks = TABLEBASE_MAX_THREADS;
+    }
+    BuildChunk chunks[TABLEBASE_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    int status = 0;
+    for (int32_t r = 0; r < nchunks; r += 1) {
+        BuildChunk* chunk = &chunks[r];
+        chunk->tb = &tb;
+        chunk->template = comps;
+        chunk->values = values;
+        chunk->start = tb.entries * r / nchunks;
+        chunk->end = tb.entries * (r + 1) / nchunks;
+        chunk->capacity = 1024;
+        chunk->firsts = malloc((chunk->end - chunk->start + 1) * sizeof(uint32_t));
+        chunk->edges = malloc(chunk->capacity * sizeof(uint32_t));
+        if (chunk->firsts == NULL || chunk->edges == NULL) {
+            ERROR("Out of memory.");
+            status = 1;
+        }
+    }
+
+    if (status == 0) {
+        status = build_run(chunks, nchunks, build_expand);
+    }
+
+    uint8_t distance = 1;
+    while (status == 0 && distance < TABLEBASE_MAX_DISTANCE) {
+        distance += 1;
+        for (int32_t r = 0; r < nchunks; r += 1) {
+            chunks[r].distance = distance;
+        }
+        status = build_run(chunks, nchunks, build_pass);
+
+        uint32_t changed = 0;
+        for (int32_t r = 0; r < nchunks; r += 1) {
+            changed += chunks[r].changed;
+        }
+        if (changed == 0) {
+            distance -= 1;
+            break;
+        }
+    }
+
+    if (status == 0) {
+        status = build_run(chunks, nchunks, build_mirror);
+    }
+    if (status == 0) {
+        status = tablebase_write(&tb, values, path);
+    }
+    if (status == 0) {
+        uint64_t legal = 0;
+        uint64_t won = 0;
+        for (uint64_t r = 0; r < tb.entries; r += 1) {
+            legal += values[r] != TABLEBASE_NONE;
+            won += values[r] != TABLEBASE_NONE && values[r] != TABLEBASE_LOST;
+        }
+        fprintf(stderr, "Wrote %s: %llu positions, %llu can be won, longest win %u moves. "
+            "Took %ums with %d threads.\n",
+            path, (unsigned long long)legal, (unsigned long long)won, distance,
+            SDL_GetTicks() - start_ticks, nchunks);
+    }
+
+    for (int32_t r = 0; r < nchunks; r += 1) {
+        free(chunks[r].firsts);
+        free(chunks[r].edges);
+    }
+    free(values);
+    return status;
+}
+
+int tablebase_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        ERROR("Usage: tablebase PACK LEVEL FILE");
+        return 1;
+    }
+    unsigned long wanted = strtoul(argv[1], NULL, 10);
+
+    char* pack = level_pack_load(argv[0]);
+    if (pack == NULL) {
+        return 1;
+    }
+
+    Components comps = components_new();
+    int status = 1;
+    bool found = false;
+    const char* text = pack;
+    for (unsigned long level_id = 1; !found && *level_skip(text) != '\0'; level_id += 1) {
+        components_clear(&comps);
+        if (level_parse(&comps, text, &text) != 0) {
+            WARN("%s level %lu doesn't parse.", argv[0], level_id);
+            break;
+        }
+        found = level_id == wanted;
+    }
+    if (found) {
+        status = tablebase_build(&comps, argv[2]);
+    } else {
+        ERROR("No level %lu in %s.", wanted, argv[0]);
+    }
+
+    components_free(&comps);
+    free(pack);
+    return status;
+}
@@ -0,0 +1,42 @@
+
+/* Values stored for each position. Anything in between is the number of moves to a win. */
+#define TABLEBASE_LOST 0
+#define TABLEBASE_MAX_DISTANCE 254
+#define TABLEBASE_NONE 255 /* Not a position that the table covers. */
+
+/*
+ Maps a tablebase file written by tablebase_build().
+ Returns: 0 if successful
+ */
+int tablebase_load(Tablebase* tb, const char* path);
+
+void tablebase_end(Tablebase* tb);
+
+/*
+ Returns: The value stored for the position in comps, or TABLEBASE_NONE if the terrain or pieces
+          don't match the table.
+ */
+uint8_t tablebase_probe(const Tablebase* tb, Components* comps);
+
+/*
+ Looks the position up in every tablebase that the state has loaded.
+ Returns: The value from the first table that covers it, or TABLEBASE_NONE.
+ */
+uint8_t tablebases_probe(State* state, Components* comps);
+
+/*
+ Finds a move that gets closest to a win according to the loaded tablebases. scratch is overwritten.
+ Returns: true if the position is covered and can still be won.
+ */
+bool tablebases_best_move(State* state, Components* scratch, Move* move);
+
+/*
+ Solves every placement of the pieces in comps on its terrain and writes the table to path.
+ Returns: 0 if successful
+ */
+int tablebase_build(Components* comps, const char* path);
+
+/*
+ Command line entry point: tablebase PACK LEVEL FILE
+ */
+int tablebase_main(int argc, char* argv[]);
@@ -4,25 +4,82 @@
 #include "constants.h"
 #include "component.h"
 #include "icon.h"
+#include "draw.h"
+#include "batch.h"
+#include "terrain.h"
+
+#define TERRAIN_ALL (TILE_COUNT == 64 ? ~(Bitboard)0 : (((Bitboard)1 << TILE_COUNT) - 1))
+
+static Bitboard tile_bit(Coord x, Coord y) {
+    return (Bitboard)1 << (y * TILES_ACROSS + x);
+}
+
+void terrain_mark(State* state, Coord tile_x, Coord tile_y) {
+    if (tile_x < 0 || tile_y < 0 || tile_x >= TILES_ACROSS || tile_y >= TILES_DOWN) {
+        return;
+    }
+    state->terrain_dirty |= tile_bit(tile_x, tile_y);
+}
+
+void terrain_invalidate(State* state) {
+    state->terrain_dirty = TERRAIN_ALL;
+}
+
+/*
+ Works out what each tile shows: the icon of its CTile, or TERRAIN_FLOOR for the plain floor.
+ */
+static void terrain_icons(State* state, IconID* icons) {
+    memset(icons, TERRAIN_FLOOR, TILE_COUNT * sizeof(IconID));
+    CompGroup* groups[] = {
+        &state->components.compgroups[COMPTYPE_TILE],
+        &state->components.compgroups[COMPTYPE_POSITION],
+    };
+    void* comps[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
+        CTile* tile = (CTile*)comps[0];
+        CPosition* position = (CPosition*)comps[1];
+        icons[position->y * TILES_ACROSS + position->x] = tile->icon_id;
+    }
+}
+
+void terrain_refresh(State* state) {
+    IconID icons[TILE_COUNT];
+    terrain_icons(state, icons);
+    for (Coord y = 0; y < TILES_DOWN; y += 1) {
+        for (Coord x = 0; x < TILES_ACROSS; x += 1) {
+            if (icons[y * TILES_ACROSS + x] != state->terrain_icons[y * TILES_ACROSS + x]) {
+                terrain_mark(state, x, y);
+            }
+        }
+    }
+}
 
 int terrain_update(State* state) {
+    Bitboard dirty = state->terrain_dirty;
+    if (dirty == 0) {
+        return 0;
+    }
+
     /* Start drawing to off-screen texture. */
     SDL_Texture* terrain_buf = state->textures[TEXTURE_TERRAIN];
     if (terrain_buf == NULL) {
         WARN("terrain buffer not initialized");
         return 1;
     }
+    batch_flush(state);
     if (SDL_SetRenderTarget(state->renderer, terrain_buf) != 0) {
         ERROR("SDL_SetRenderTarget");
         return 1;
     }
 
-    /* Turn everything magenta to show undrawn locations. */
+    /* Turn the tiles magenta to show undrawn locations. */
     if (SDL_SetRenderDrawColor(state->renderer, 255, 0, 255, 255) != 0) {
         WARN("SDL_SetRenderDrawColor");
     }
-    if (SDL_RenderClear(state->renderer) != 0) {
-        WARN("SDL_RenderClear");
+    if (dirty == TERRAIN_ALL) {
+        if (SDL_RenderClear(state->renderer) != 0) {
+            WARN("SDL_RenderClear");
+        }
     }
 
     /* Default floor tiles. */
@@ -35,9 +92,16 @@ int terrain_update(State* state) {
     };
     for (int y = 0; y < TILES_DOWN; y += 1) {
         for (int x = 0; x < TILES_ACROSS; x += 1) {
+            if ((dirty & tile_bit(x, y)) == 0) {
+                continue;
+            }
             dest_rect.x = x * TILE_SIZE;
             dest_rect.y = y * TILE_SIZE;
 
+            if (dirty != TERRAIN_ALL && SDL_RenderFillRect(state->renderer, &dest_rect) != 0) {
+                WARN("SDL_RenderFillRect");
+            }
+
             IconID icon_id = ICON_FLOOR_A;
             if ((x + y) % 2 == 0) {
                 icon_id = ICON_FLOOR_B;
@@ -57,13 +121,25 @@ int terrain_update(State* state) {
     while (component_iterate((CompGroup**)&groups, (void**)&comps, 2)) {
         CTile* tile = (CTile*)comps[0];
         CPosition* position = (CPosition*)comps[1];
+        if ((dirty & tile_bit(position->x, position->y)) == 0) {
+            continue;
+        }
 
         dest_rect.x = TILE_SIZE * position->x;
         dest_rect.y = TILE_SIZE * position->y;
 
         icon_draw(state, tile->icon_id, &dest_rect);
     }
+    batch_flush(state);
 
+    IconID icons[TILE_COUNT];
+    terrain_icons(state, icons);
+    for (uint8_t r = 0; r < TILE_COUNT; r += 1) {
+        if ((dirty & ((Bitboard)1 << r)) != 0) {
+            state->terrain_icons[r] = icons[r];
+        }
+    }
+    state->terrain_dirty = 0;
     return 0;
 }
 
@@ -85,6 +161,7 @@ int terrain_init(State* state) {
         return 1;
     }
     state->textures[TEXTURE_TERRAIN] = terrain;
+    terrain_invalidate(state);
 
     /* Initialize tiles. */
 
@@ -97,7 +174,5 @@ int terrain_init(State* state) {
 }
 
 void terrain_draw(State* state) {
-    if (SDL_RenderCopy(state->renderer, state->textures[TEXTURE_TERRAIN], NULL, NULL) != 0) {
-        WARN("SDL_RenderCopy");
-    }
+    draw_texture(state, TEXTURE_TERRAIN, NULL, NULL);
 }
@@ -1,4 +1,25 @@
 
+/*
+ Redraws the tiles of the terrain buffer that have been marked since the last update.
+ Returns: 0 if successful
+ */
 int terrain_update(State* state);
+
+/*
+ Marks a tile whose terrain has changed so that the next terrain_update() redraws it.
+ */
+void terrain_mark(State* state, Coord tile_x, Coord tile_y);
+
+/*
+ Marks the tiles that show something different from what was last drawn of them, like after
+ another level is built. Restarting a level leaves nothing to redraw.
+ */
+void terrain_refresh(State* state);
+
+/*
+ Marks every tile, for when the whole level changes or the buffer's contents are lost.
+ */
+void terrain_invalidate(State* state);
+
 int terrain_init(State* state);
 void terrain_draw(State* state);
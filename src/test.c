@@ -12,6 +12,21 @@
 #include "event.h"
 #include "draw.h"
 #include "terrain.h"
+#include "board.h"
+#include "interact.h"
+#include "solve.h"
+#include "count.h"
+#include "doom.h"
+#include "tablebase.h"
+#include "disk.h"
+#include "env.h"
+#include "ai.h"
+#include "route.h"
+#include "preview.h"
+#include "atlas.h"
+#include "assets.h"
+#include "tween.h"
+#include "render.h"
 
 #include "minunit.h"
 
@@ -432,6 +447,853 @@ static char* test_component_for_entity() {
     return 0;
 }
 
+static char* test_compgroup_copy() {
+    CompGroup groupa = compgroup_init(3, sizeof(CompInt));
+    CompGroup groupb = compgroup_init(3, sizeof(CompInt));
+    CompGroup small = compgroup_init(1, sizeof(CompInt));
+
+    comp_int_init(&groupa, 1, 4);
+    comp_int_init(&groupa, 2, 8);
+    comp_int_init(&groupb, 3, 16);
+
+    mu_assert(compgroup_copy(&groupb, &groupa) == 0, "");
+    mu_assert(groupb.alive == 2, "");
+    CompInt* comps = (CompInt*)groupb.mem;
+    mu_assert(comps[0].entity == 1, "");
+    mu_assert(comps[0].val == 4, "");
+    mu_assert(comps[1].entity == 2, "");
+    mu_assert(comps[1].val == 8, "");
+
+    mu_assert(compgroup_copy(&small, &groupa) != 0, "");
+    mu_assert(small.alive == 0, "");
+
+    compgroup_free(&groupa);
+    compgroup_free(&groupb);
+    compgroup_free(&small);
+    return 0;
+}
+
+static char* test_level_text_roundtrip() {
+    Components comps = components_new();
+    mu_assert(level_build(&comps, 2) == 0, "");
+
+    char text[LEVEL_TEXT_SIZE];
+    mu_assert(level_format(&comps, text, sizeof(text)) == 0, "");
+
+    Components parsed = components_new();
+    mu_assert(level_parse(&parsed, text, NULL) == 0, "");
+
+    char again[LEVEL_TEXT_SIZE];
+    mu_assert(level_format(&parsed, again, sizeof(again)) == 0, "");
+    mu_assert(strcmp(text, again) == 0, "");
+    mu_assert(parsed.compgroups[COMPTYPE_POSITION].alive
+        == comps.compgroups[COMPTYPE_POSITION].alive, "");
+
+    components_free(&comps);
+    components_free(&parsed);
+    return 0;
+}
+
+static char* test_solve_level() {
+    Components comps = components_new();
+    mu_assert(level_build(&comps, 1) == 0, "");
+
+    SolveLimits limits = {0, 0, 0, NULL};
+    SolveResult* result = malloc(sizeof(SolveResult));
+    mu_assert(result != NULL, "");
+    mu_assert(solve(&comps, &limits, result) == 0, "");
+    mu_assert(result->solved, "");
+    mu_assert(result->length == 4, "");
+
+    Outcome outcome = OutcomeInvalid;
+    for (uint16_t r = 0; r < result->length; r += 1) {
+        Move* move = &result->moves[r];
+        outcome = components_command_move(&comps, move->subject, move->x, move->y);
+        mu_assert(outcome != OutcomeInvalid && outcome != OutcomeLost, "");
+    }
+    mu_assert(outcome == OutcomeWon, "");
+
+    free(result);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_disk_solve() {
+    Components comps = components_new();
+    mu_assert(level_build(&comps, 3) == 0, "");
+
+    SolveLimits limits = {0, 0, 0, NULL};
+    SolveResult* result = malloc(sizeof(SolveResult));
+    mu_assert(disk_solve(&comps, ".", &limits, result) == 0, "");
+    mu_assert(result->solved, "");
+    mu_assert(result->length == 6, "");
+
+    Outcome outcome = OutcomeInvalid;
+    for (uint16_t r = 0; r < result->length; r += 1) {
+        Move* move = &result->moves[r];
+        outcome = components_command_move(&comps, move->subject, move->x, move->y);
+    }
+    mu_assert(outcome == OutcomeWon, "");
+
+    free(result);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_solver_symmetry() {
+    const char* text =
+        "^########^\n"
+        "#........#\n"
+        "#.K.S..D.#\n"
+        "#...H....#\n"
+        "#........#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+
+    Solver solver;
+    mu_assert(solver_init(&solver, &comps) == 0, "");
+    mu_assert(solver.symmetries == 0xF, "");
+
+    BoardKey key = solver_key(&solver, &comps);
+    uint8_t transform;
+    BoardKey canonical = solver_canonical(&solver, &key, &transform);
+    BoardKey back = solver_transform(&solver, &canonical, transform);
+    mu_assert(memcmp(&back, &key, sizeof(BoardKey)) == 0, "");
+
+    /* Every mirror image has the same canonical key. */
+    for (uint8_t t = 1; t < SOLVE_TRANSFORMS; t += 1) {
+        BoardKey mirrored = solver_transform(&solver, &key, t);
+        BoardKey other = solver_canonical(&solver, &mirrored, &transform);
+        mu_assert(memcmp(&other, &canonical, sizeof(BoardKey)) == 0, "");
+    }
+    solver_end(&solver);
+
+    /* Level 2 has walls on one side only. */
+    components_clear(&comps);
+    mu_assert(level_build(&comps, 2) == 0, "");
+    mu_assert(solver_init(&solver, &comps) == 0, "");
+    mu_assert(solver.symmetries == 1, "");
+    solver_end(&solver);
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_count_solutions() {
+    Components comps = components_new();
+    mu_assert(level_build(&comps, 1) == 0, "");
+
+    uint64_t count = 0;
+    mu_assert(count_solutions(&comps, 3, 1000, &count) == 0, "");
+    mu_assert(count == 0, "");
+    mu_assert(count_solutions(&comps, 4, 1000, &count) == 0, "");
+    mu_assert(count == 2, "");
+    mu_assert(count_solutions(&comps, 6, 1000, &count) == 0, "");
+    mu_assert(count == 6, "");
+
+    /* Same answer when nothing can be memoized. */
+    mu_assert(count_solutions(&comps, 6, 0, &count) == 0, "");
+    mu_assert(count == 6, "");
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_doom_lost() {
+    Components comps = components_new();
+    Doom doom;
+    memset(&doom, 0, sizeof(doom));
+
+    mu_assert(level_build(&comps, 1) == 0, "");
+    mu_assert(!doom_lost(&doom, &comps), "");
+
+    /* The knight can never get to the horse. */
+    const char* text =
+        "^########^\n"
+        "#K#......#\n"
+        "###...D..#\n"
+        "#....H...#\n"
+        "#.....S..#\n"
+        "^########^\n";
+    components_clear(&comps);
+    doom_reset(&doom);
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    mu_assert(doom_lost(&doom, &comps), "");
+
+    /* One of the dragons is out of the knight's reach. */
+    text =
+        "^########^\n"
+        "#K.H..#D.#\n"
+        "#.....####\n"
+        "#...D....#\n"
+        "#.....S..#\n"
+        "^########^\n";
+    components_clear(&comps);
+    doom_reset(&doom);
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    mu_assert(doom_lost(&doom, &comps), "");
+
+    doom_end(&doom);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_tablebase() {
+    const char* text =
+        "##########\n"
+        "##########\n"
+        "##K.H.S.##\n"
+        "##.#..D.##\n"
+        "##########\n"
+        "##########\n";
+    const char* path = "test_tablebase.bin";
+
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    mu_assert(tablebase_build(&comps, path) == 0, "");
+
+    Tablebase tb;
+    int loaded = tablebase_load(&tb, path);
+    remove(path);
+    mu_assert(loaded == 0, "");
+
+    SolveLimits limits = {0, 0, 0, NULL};
+    SolveResult* result = malloc(sizeof(SolveResult));
+    mu_assert(solve(&comps, &limits, result) == 0, "");
+    mu_assert(result->solved, "");
+    mu_assert(tablebase_probe(&tb, &comps) == result->length, "");
+
+    /* Every move of the shortest solution gets one step closer. */
+    for (uint16_t r = 0; r + 1 < result->length; r += 1) {
+        Move* move = &result->moves[r];
+        mu_assert(components_command_move(&comps, move->subject, move->x, move->y) == OutcomeMoved,
+            "");
+        mu_assert(tablebase_probe(&tb, &comps) == result->length - r - 1, "");
+    }
+
+    /* Different terrain isn't covered. */
+    components_clear(&comps);
+    mu_assert(level_build(&comps, 1) == 0, "");
+    mu_assert(tablebase_probe(&tb, &comps) == TABLEBASE_NONE, "");
+
+    free(result);
+    tablebase_end(&tb);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_env_step() {
+    VecEnv* env = env_new(4, NULL);
+    mu_assert(env != NULL, "");
+    LevelID level_ids[] = {1, 1, 2, 3};
+    env_reset(env, level_ids);
+    mu_assert(env->observations[ENV_PLANE_WALL] == terrain_bits(&env->comps[0]), "");
+
+    Components comps = components_new();
+    mu_assert(level_build(&comps, 1) == 0, "");
+    SolveLimits limits = {0, 0, 0, NULL};
+    SolveResult* result = malloc(sizeof(SolveResult));
+    mu_assert(solve(&comps, &limits, result) == 0 && result->solved, "");
+
+    /* Instance 1 plays the solution. The others keep trying a move that is never legal. */
+    uint8_t actions[] = {ENV_ACTIONS - 1, 0, ENV_ACTIONS - 1, ENV_ACTIONS - 1};
+    for (uint16_t r = 0; r < result->length; r += 1) {
+        Move* move = &result->moves[r];
+        CPosition* position = component_of(
+            &env->comps[1].compgroups[COMPTYPE_POSITION], move->subject);
+        mu_assert(position != NULL, "");
+        uint8_t dir = move->y < position->y ? 0 : move->x > position->x ? 1
+            : move->y > position->y ? 2 : 3;
+        uint8_t piece = 0;
+        while (env->pieces[ENV_MAX_PIECES + piece] != move->subject) {
+            piece += 1;
+        }
+        actions[1] = piece * 4 + dir;
+
+        mu_assert(!env->dones[1], "");
+        env_step(env, actions);
+        mu_assert(env->rewards[0] == ENV_REWARD_INVALID, "");
+    }
+    mu_assert(env->rewards[1] == ENV_REWARD_WON, "");
+    mu_assert(env->dones[1], "");
+    mu_assert(!env->dones[0] && !env->dones[2] && !env->dones[3], "");
+
+    /* Done instances sit out until they are reset. */
+    env_step(env, actions);
+    mu_assert(env->rewards[1] == 0, "");
+    env_reset_one(env, 1, 1);
+    mu_assert(!env->dones[1] && env->steps[1] == 0, "");
+
+    free(result);
+    components_free(&comps);
+    env_end(env);
+    return 0;
+}
+
+static char* test_cooldown_eaten() {
+    const char* text =
+        "^########^\n"
+        "#K.......#\n"
+        "#........#\n"
+        "#...H.D..#\n"
+        "#........#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    Entity knight = type_at(&comps, COMPTYPE_RIDER, 1, 1);
+    Entity horse = type_at(&comps, COMPTYPE_MOUNT, 4, 3);
+    Entity dragon = type_at(&comps, COMPTYPE_SLAYME, 6, 3);
+    mu_assert(knight != 0 && horse != 0 && dragon != 0, "");
+
+    mu_assert(components_command_move(&comps, horse, 5, 3) == OutcomeMoved, "");
+    mu_assert(cooldown_active(&comps, horse) && comps.nmoved == 1, "");
+
+    /* The horse stops counting as moved once it's eaten, so the knight still has to move. */
+    mu_assert(components_command_move(&comps, dragon, 5, 3) != OutcomeInvalid, "");
+    mu_assert(component_of(&comps.compgroups[COMPTYPE_POSITION], horse) == NULL, "");
+    mu_assert(comps.compgroups[COMPTYPE_SELECTABLE].alive == 2, "");
+    mu_assert(comps.nmoved == 1, "");
+    mu_assert(cooldown_active(&comps, dragon) && !cooldown_active(&comps, knight), "");
+
+    mu_assert(components_command_move(&comps, knight, 2, 1) != OutcomeInvalid, "");
+    mu_assert(comps.nmoved == 0, "");
+    mu_assert(!cooldown_active(&comps, dragon) && !cooldown_active(&comps, knight), "");
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_ai_think() {
+    /* The dragon can go for the knight above it or eat the sheep beside it right away. */
+    const char* text =
+        "^########^\n"
+        "#...K....#\n"
+        "#........#\n"
+        "#...DS.H.#\n"
+        "#........#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    mu_assert(!ai_turn(&comps), "");
+
+    Entity dragon = type_at(&comps, COMPTYPE_SLAYME, 4, 3);
+    Entity pieces[] = {
+        type_at(&comps, COMPTYPE_RIDER, 4, 1),
+        type_at(&comps, COMPTYPE_MOUNT, 7, 3),
+    };
+    for (uint8_t r = 0; r < 2; r += 1) {
+        mu_assert(pieces[r] != 0, "");
+        cooldown_start(&comps, pieces[r]);
+        mu_assert(cooldown_active(&comps, pieces[r]), "");
+    }
+    mu_assert(ai_turn(&comps), "");
+
+    Move move;
+    mu_assert(ai_think(&comps, 200, NULL, &move), "");
+    mu_assert(move.subject == dragon && move.x == 5 && move.y == 3, "");
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_route_plan() {
+    const char* text =
+        "^########^\n"
+        "#K.#.....#\n"
+        "#..#.....#\n"
+        "#.....H..#\n"
+        "#.S...C.D#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+
+    Route route;
+    memset(&route, 0, sizeof(route));
+    route.scratch = components_new();
+    route.trial = components_new();
+    route.subject = type_at(&comps, COMPTYPE_RIDER, 1, 1);
+    route.target_x = 4;
+    route.target_y = 1;
+    mu_assert(route_plan(&route, &comps) == 0, "");
+
+    /* Around the wall takes 7 moves of the knight. The other pieces each move in between. */
+    uint16_t nsubject = 0;
+    for (uint16_t r = 0; r < route.nmoves; r += 1) {
+        Move* move = &route.moves[r];
+        mu_assert(!cooldown_active(&comps, move->subject), "");
+        mu_assert(components_command_move(&comps, move->subject, move->x, move->y)
+            == OutcomeMoved, "");
+        if (move->subject == route.subject) {
+            nsubject += 1;
+        }
+    }
+    mu_assert(nsubject == 7, "");
+    CPosition* position = component_of(&comps.compgroups[COMPTYPE_POSITION], route.subject);
+    mu_assert(position->x == 4 && position->y == 1, "");
+
+    /* Walled in. */
+    route.target_x = 0;
+    route.target_y = 0;
+    mu_assert(route_plan(&route, &comps) != 0, "");
+
+    components_free(&route.scratch);
+    components_free(&route.trial);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_herd() {
+    /* The sheep in front moves first, so the one behind it isn't blocked. */
+    const char* text =
+        "^########^\n"
+        "#K.......#\n"
+        "#..SS..S.#\n"
+        "#.....S..#\n"
+        "#C......D#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+
+    Entity dog = type_at(&comps, COMPTYPE_HERDER, 1, 4);
+    mu_assert(components_command_move(&comps, dog, 2, 4) == OutcomeMoved, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 4, 2) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 5, 2) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 8, 2) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 7, 3) != 0, "");
+
+    /* Against the wall they stay put while the rest catch up. */
+    /* The dog moves on its own so its cooldown is cleared by hand. */
+    cooldown_reset(&comps);
+    mu_assert(components_command_move(&comps, dog, 2, 3) == OutcomeMoved, "");
+    cooldown_reset(&comps);
+    mu_assert(components_command_move(&comps, dog, 2, 2) == OutcomeMoved, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 4, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 5, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 8, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 7, 1) != 0, "");
+
+    cooldown_reset(&comps);
+    mu_assert(components_command_move(&comps, dog, 1, 2) == OutcomeMoved, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 3, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 4, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 6, 1) != 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 7, 1) != 0, "");
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_multiple_dragons() {
+    const char* text =
+        "^########^\n"
+        "#KH...D..#\n"
+        "#........#\n"
+        "#........#\n"
+        "#HK...D.S#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    mu_assert(comps.compgroups[COMPTYPE_SLAYME].alive == 2, "");
+
+    /* Each knight mounts the horse it walks onto. */
+    Entity top = type_at(&comps, COMPTYPE_RIDER, 1, 1);
+    Entity bottom = type_at(&comps, COMPTYPE_RIDER, 2, 4);
+    mu_assert(components_command_move(&comps, top, 2, 1) == OutcomeMoved, "");
+    mu_assert(components_command_move(&comps, bottom, 1, 4) == OutcomeMoved, "");
+    mu_assert(component_of(&comps.compgroups[COMPTYPE_SLAYER], top) != NULL, "");
+    mu_assert(component_of(&comps.compgroups[COMPTYPE_SLAYER], bottom) != NULL, "");
+    mu_assert(type_at(&comps, COMPTYPE_MOUNT, 2, 1) == 0, "");
+    mu_assert(type_at(&comps, COMPTYPE_SLAYER, 2, 1) == top, "");
+
+    /* Slaying one dragon doesn't win while the other is left. */
+    CPosition* position = component_of(&comps.compgroups[COMPTYPE_POSITION], top);
+    position_set(&comps, position, 5, 1);
+    cooldown_reset(&comps);
+    mu_assert(components_command_move(&comps, top, 6, 1) == OutcomeMoved, "");
+    mu_assert(comps.compgroups[COMPTYPE_SLAYME].alive == 1, "");
+    mu_assert(type_at(&comps, COMPTYPE_AVATAR, 5, 1) == 0, "");
+
+    position = component_of(&comps.compgroups[COMPTYPE_POSITION], bottom);
+    position_set(&comps, position, 5, 4);
+    cooldown_reset(&comps);
+    mu_assert(components_command_move(&comps, bottom, 6, 4) == OutcomeWon, "");
+
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_preview() {
+    const char* text =
+        "^########^\n"
+        "#K.......#\n"
+        "#..SS....#\n"
+        "#.....SD.#\n"
+        "#C.......#\n"
+        "^########^\n";
+    Components comps = components_new();
+    Components view = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    Entity dog = type_at(&comps, COMPTYPE_HERDER, 1, 4);
+    Entity dragon = type_at(&comps, COMPTYPE_SLAYME, 7, 3);
+    Entity sheep = type_at(&comps, COMPTYPE_FLOCK, 3, 2);
+
+    /* The herded sheep move in the view and not on the board. */
+    mu_assert(preview_move(&view, &comps, dog, 2, 4) == OutcomeMoved, "");
+    mu_assert(type_at(&view, COMPTYPE_FLOCK, 4, 2) == sheep, "");
+    mu_assert(type_at(&view, COMPTYPE_FLOCK, 5, 2) != 0, "");
+    mu_assert(type_at(&view, COMPTYPE_HERDER, 2, 4) == dog, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 3, 2) == sheep, "");
+    mu_assert(type_at(&comps, COMPTYPE_HERDER, 1, 4) == dog, "");
+    mu_assert(!cooldown_active(&comps, dog), "");
+
+    /* A meal for the dragon. */
+    mu_assert(preview_move(&view, &comps, dragon, 6, 3) == OutcomeLost, "");
+    mu_assert(type_at(&view, COMPTYPE_SLAYME, 6, 3) == dragon, "");
+    mu_assert(type_at(&comps, COMPTYPE_FLOCK, 6, 3) != 0, "");
+
+    mu_assert(preview_move(&view, &comps, dog, 0, 4) == OutcomeInvalid, "");
+
+    components_free(&view);
+    components_free(&comps);
+    return 0;
+}
+
+static char* test_preview_update() {
+    const char* text =
+        "^########^\n"
+        "#.......D#\n"
+        "#.M.D....#\n"
+        "#........#\n"
+        "#....H...#\n"
+        "^########^\n";
+    State* state = calloc(1, sizeof(State));
+    mu_assert(state != NULL, "");
+    state->components = components_new();
+    state->preview.view = components_new();
+    Components* comps = &state->components;
+    mu_assert(level_parse(comps, text, NULL) == 0, "");
+    Entity knight = type_at(comps, COMPTYPE_SLAYER, 2, 2);
+    Entity dragon = type_at(comps, COMPTYPE_SLAYME, 4, 2);
+    Entity horse = type_at(comps, COMPTYPE_MOUNT, 5, 4);
+
+    mu_assert(components_command_move(comps, dragon, 3, 2) == OutcomeMoved, "");
+    state->selection = (Selection){6, 4, 5, 4, horse, HoverValid};
+    preview_update(state);
+    mu_assert(type_at(&state->preview.view, COMPTYPE_SLAYME, 3, 2) == dragon, "");
+
+    /* The slain dragon had moved already, so the round and the count that moved in it stay put. */
+    uint32_t round = comps->round;
+    uint32_t nmoved = comps->nmoved;
+    mu_assert(components_command_move(comps, knight, 3, 2) == OutcomeMoved, "");
+    mu_assert(comps->round == round && comps->nmoved == nmoved, "");
+    preview_update(state);
+    mu_assert(type_at(&state->preview.view, COMPTYPE_SLAYME, 3, 2) == 0, "");
+    mu_assert(type_at(&state->preview.view, COMPTYPE_SLAYER, 3, 2) == knight, "");
+
+    components_free(&state->preview.view);
+    components_free(&state->components);
+    free(state);
+    return 0;
+}
+
+static char* test_atlas_pack() {
+    SDL_Rect rects[] = {
+        {0, 0, 320, 320}, {0, 0, 128, 128}, {0, 0, 128, 128}, {0, 0, 128, 128},
+        {0, 0, 128, 128}, {0, 0, 128, 128}, {0, 0, 128, 128}, {0, 0, 128, 128},
+        {0, 0, 351, 169}, {0, 0, 232, 48}, {0, 0, 186, 51},
+    };
+    uint8_t count = sizeof(rects) / sizeof(rects[0]);
+    int32_t height;
+    mu_assert(atlas_pack(rects, count, 1024, &height) == 0, "");
+    mu_assert(height > 0 && height <= 1024, "");
+
+    for (uint8_t r = 0; r < count; r += 1) {
+        mu_assert(rects[r].x >= 0 && rects[r].x + rects[r].w <= 1024, "");
+        mu_assert(rects[r].y >= 0 && rects[r].y + rects[r].h <= height, "");
+        for (uint8_t s = 0; s < r; s += 1) {
+            mu_assert(!SDL_HasIntersection(&rects[r], &rects[s]), "");
+        }
+    }
+
+    SDL_Rect wide = {0, 0, 2000, 10};
+    mu_assert(atlas_pack(&wide, 1, 1024, &height) != 0, "");
+    return 0;
+}
+
+static char* test_atlas_decode() {
+    /* Not PNGs, so every image fails to decode, but each one still has to be claimed once. */
+    static const uint8_t junk[] = {1, 2, 3, 4};
+    AtlasImage images[5];
+    for (uint8_t r = 0; r < 5; r += 1) {
+        images[r] = (AtlasImage){TEXTURE_ATLAS, "junk", junk, sizeof(junk)};
+    }
+
+    AtlasDecode decode;
+    mu_assert(atlas_decode_start(&decode, images, 5, true) == 0, "");
+    mu_assert(decode.started && decode.nthreads <= 5, "");
+    mu_assert(atlas_decode_wait(&decode) != 0, "");
+    mu_assert(SDL_AtomicGet(&decode.next) >= 5, "");
+    mu_assert(decode.nthreads == 0 && atlas_decode_ready(&decode), "");
+    for (uint8_t r = 0; r < 5; r += 1) {
+        mu_assert(decode.surfaces[r] == NULL, "");
+    }
+    atlas_decode_free(&decode);
+    mu_assert(!decode.started && !atlas_decode_ready(&decode), "");
+    mu_assert(atlas_decode_wait(&decode) != 0, "");
+    atlas_decode_free(&decode);
+
+    /* Freeing while the workers may still be going waits for them. */
+    mu_assert(atlas_decode_start(&decode, images, 5, false) == 0, "");
+    atlas_decode_free(&decode);
+    mu_assert(!decode.started && decode.nthreads == 0, "");
+
+    mu_assert(atlas_decode_start(&decode, images, 0, true) == 0, "");
+    mu_assert(atlas_decode_wait(&decode) == 0, "");
+    atlas_decode_free(&decode);
+
+    mu_assert(atlas_decode_start(&decode, images, ATLAS_MAX_IMAGES + 1, true) != 0, "");
+    return 0;
+}
+
+/* Blank surfaces of made up sizes in place of decoding, with nothing left for workers to claim. */
+static void assets_decoded(AtlasDecode* decode, const AtlasImage* images, uint8_t count) {
+    memset(decode, 0, sizeof(AtlasDecode));
+    decode->started = true;
+    decode->images = images;
+    decode->count = count;
+    SDL_AtomicSet(&decode->next, count);
+    for (uint8_t r = 0; r < count; r += 1) {
+        decode->surfaces[r] =
+            SDL_CreateRGBSurfaceWithFormat(0, 8 + r, 4 + r, 32, SDL_PIXELFORMAT_RGBA32);
+    }
+}
+
+/*
+ Writes the first size bytes of mem to path, with the byte at offset changed to value unless
+ offset is past the end.
+ Returns: 0 if successful
+ */
+static int assets_rewrite(const char* path, const uint8_t* mem, size_t size, size_t offset,
+        uint8_t value) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return 1;
+    }
+    bool written = true;
+    for (size_t r = 0; written && r < size; r += 1) {
+        written = fputc(r == offset ? value : mem[r], file) != EOF;
+    }
+    return fclose(file) != 0 || !written;
+}
+
+static char* test_assets_check() {
+    static const uint8_t png_a[] = {1, 2, 3};
+    static const uint8_t png_b[] = {4, 5, 6, 7};
+    static const uint8_t png_c[] = {8, 9};
+    AtlasImage sprites[] = {
+        {TEXTURE_DRAGON, "a", png_a, sizeof(png_a)},
+        {TEXTURE_KNIGHT, "b", png_b, sizeof(png_b)},
+    };
+    AtlasImage captions[] = {
+        {TEXTURE_INSTRUCTIONS, "c", png_c, sizeof(png_c)},
+    };
+    AssetsSource source = {sprites, 2, captions, 1};
+    const char* path = "test_assets.bin";
+
+    AtlasDecode sprites_decoded;
+    AtlasDecode captions_decoded;
+    assets_decoded(&sprites_decoded, sprites, 2);
+    assets_decoded(&captions_decoded, captions, 1);
+    int baked = assets_bake_decoded(&source, &sprites_decoded, &captions_decoded, path);
+    atlas_decode_free(&sprites_decoded);
+    atlas_decode_free(&captions_decoded);
+    mu_assert(baked == 0, "");
+    mu_assert(assets_check(&source, path) == 0, "");
+
+    FILE* file = fopen(path, "rb");
+    mu_assert(file != NULL, "");
+    uint8_t* mem = malloc(1 << 20);
+    size_t size = fread(mem, 1, 1 << 20, file);
+    fclose(file);
+    mu_assert(size > 16 && size < (1 << 20), "");
+
+    /* Made from other images, even by one byte. */
+    static const uint8_t png_d[] = {8, 10};
+    captions[0].mem = png_d;
+    mu_assert(assets_check(&source, path) != 0, "");
+    captions[0].mem = png_c;
+    mu_assert(assets_check(&source, path) == 0, "");
+
+    /* Cut short, or a header of another version. The version follows the 8 bytes of magic. */
+    mu_assert(assets_rewrite(path, mem, size - 1, size, 0) == 0, "");
+    mu_assert(assets_check(&source, path) != 0, "");
+    mu_assert(assets_rewrite(path, mem, size, 8, mem[8] + 1) == 0, "");
+    mu_assert(assets_check(&source, path) != 0, "");
+    mu_assert(assets_rewrite(path, mem, size, size, 0) == 0, "");
+    mu_assert(assets_check(&source, path) == 0, "");
+
+    remove(path);
+    mu_assert(assets_check(&source, path) != 0, "");
+    free(mem);
+    return 0;
+}
+
+static char* test_render_sort() {
+    uint32_t keys[] = {
+        (LAYER_TEXT << 24) | (TEXTURE_ATLAS << 16),
+        (LAYER_TERRAIN << 24) | (TEXTURE_TERRAIN << 16),
+        (LAYER_AVATAR << 24) | (TEXTURE_ATLAS << 16),
+        (LAYER_SELECT << 24) | (TEXTURE_COUNT << 16) | 1,
+        (LAYER_AVATAR << 24) | (TEXTURE_DRAGON << 16),
+        (LAYER_SELECT << 24) | (TEXTURE_COUNT << 16) | 0,
+        (LAYER_AVATAR << 24) | (TEXTURE_ATLAS << 16),
+        (LAYER_SELECT << 24) | (TEXTURE_COUNT << 16) | 1,
+    };
+    uint32_t count = sizeof(keys) / sizeof(keys[0]);
+    RenderKey sorted[8];
+    RenderKey scratch[8];
+    for (uint32_t r = 0; r < count; r += 1) {
+        sorted[r].key = keys[r];
+        sorted[r].index = r;
+    }
+    render_sort(sorted, scratch, count);
+
+    uint32_t expected[] = {1, 5, 3, 7, 4, 2, 6, 0};
+    for (uint32_t r = 0; r < count; r += 1) {
+        mu_assert(sorted[r].index == expected[r], "");
+        mu_assert(sorted[r].key == keys[expected[r]], "");
+    }
+    return 0;
+}
+
+static char* test_terrain_refresh() {
+    const char* text =
+        "^########^\n"
+        "#K.......#\n"
+        "#...#....#\n"
+        "#........#\n"
+        "#.......D#\n"
+        "^########^\n";
+    const char* changed =
+        "^########^\n"
+        "#K.......#\n"
+        "#........#\n"
+        "#.....#..#\n"
+        "#.......D#\n"
+        "^########^\n";
+    State* state = calloc(1, sizeof(State));
+    mu_assert(state != NULL, "");
+    state->components = components_new();
+    memset(state->terrain_icons, TERRAIN_FLOOR, sizeof(state->terrain_icons));
+    mu_assert(level_parse(&state->components, text, NULL) == 0, "");
+
+    /* Over a plain floor only the walls need drawing. */
+    terrain_refresh(state);
+    mu_assert(state->terrain_dirty == terrain_bits(&state->components), "");
+
+    /* What terrain_update() would have drawn. */
+    CompGroup* groups[] = {
+        &state->components.compgroups[COMPTYPE_TILE],
+        &state->components.compgroups[COMPTYPE_POSITION],
+    };
+    void* iter[] = {NULL, NULL};
+    while (component_iterate((CompGroup**)&groups, (void**)&iter, 2)) {
+        CPosition* position = (CPosition*)iter[1];
+        state->terrain_icons[position->y * TILES_ACROSS + position->x] =
+            ((CTile*)iter[0])->icon_id;
+    }
+    state->terrain_dirty = 0;
+
+    /* Restarting the same level redraws nothing. */
+    components_clear(&state->components);
+    mu_assert(level_parse(&state->components, text, NULL) == 0, "");
+    terrain_refresh(state);
+    mu_assert(state->terrain_dirty == 0, "");
+
+    /* Only the wall that moved. */
+    components_clear(&state->components);
+    mu_assert(level_parse(&state->components, changed, NULL) == 0, "");
+    terrain_refresh(state);
+    Bitboard moved =
+        ((Bitboard)1 << (2 * TILES_ACROSS + 4)) | ((Bitboard)1 << (3 * TILES_ACROSS + 6));
+    mu_assert(state->terrain_dirty == moved, "");
+
+    terrain_invalidate(state);
+    mu_assert(state->terrain_dirty == ((Bitboard)1 << TILE_COUNT) - 1, "");
+
+    components_free(&state->components);
+    free(state);
+    return 0;
+}
+
+static char* test_tween_rest() {
+    const char* text =
+        "^########^\n"
+        "#K.......#\n"
+        "#........#\n"
+        "#........#\n"
+        "#.......D#\n"
+        "^########^\n";
+    State* state = calloc(1, sizeof(State));
+    mu_assert(state != NULL, "");
+    state->components = components_new();
+    mu_assert(level_parse(&state->components, text, NULL) == 0, "");
+    mu_assert(!tween_update(state, 0.0f), "");
+
+    Entity knight = type_at(&state->components, COMPTYPE_RIDER, 1, 1);
+    mu_assert(components_command_move(&state->components, knight, 2, 1) == OutcomeMoved, "");
+    CAvatar* avatar = component_of(&state->components.compgroups[COMPTYPE_AVATAR], knight);
+
+    /* As far along after a tenth of a second at 60fps as at 240fps. */
+    for (uint8_t r = 0; r < 6; r += 1) {
+        mu_assert(tween_update(state, 1.0f / 60), "");
+    }
+    float_t at_60 = avatar->x;
+    avatar->x = 1.0f;
+    for (uint8_t r = 0; r < 24; r += 1) {
+        mu_assert(tween_update(state, 1.0f / 240), "");
+    }
+    mu_assert(fabsf(avatar->x - at_60) < 0.001f && at_60 > 1.5f, "");
+
+    uint16_t frames = 0;
+    while (tween_update(state, 1.0f / 60)) {
+        frames += 1;
+        mu_assert(frames < 100, "");
+    }
+    mu_assert(avatar->x == 2.0f && avatar->y == 1.0f, "");
+
+    components_free(&state->components);
+    free(state);
+    return 0;
+}
+
+static char* test_rules() {
+    const char* text =
+        "^########^\n"
+        "#.KDS....#\n"
+        "#........#\n"
+        "#........#\n"
+        "#........#\n"
+        "^########^\n";
+    Components comps = components_new();
+    mu_assert(level_parse(&comps, text, NULL) == 0, "");
+    Entity knight = type_at(&comps, COMPTYPE_RIDER, 2, 1);
+    Entity dragon = type_at(&comps, COMPTYPE_SLAYME, 3, 1);
+
+    /* No rule lets a knight on foot past the dragon. */
+    mu_assert(!components_will_move(&comps, knight, 3, 1), "");
+    mu_assert(components_command_move(&comps, knight, 3, 1) == OutcomeInvalid, "");
+
+    mu_assert(components_will_move(&comps, dragon, 2, 1), "");
+    mu_assert(components_command_move(&comps, dragon, 2, 1) == OutcomeLost, "");
+    mu_assert(component_of(&comps.compgroups[COMPTYPE_POSITION], knight) == NULL, "");
+    mu_assert(type_at(&comps, COMPTYPE_SLAYME, 2, 1) == dragon, "");
+
+    components_free(&comps);
+    return 0;
+}
+
 int main(int argc, char **argv) {
     mu_run_test(test_new_component);
     mu_run_test(test_compbgone32);
@@ -448,6 +1310,29 @@ int main(int argc, char **argv) {
     mu_run_test(test_iterate_partial);
     mu_run_test(test_iterate_partial_skip);
     mu_run_test(test_component_for_entity);
+    mu_run_test(test_compgroup_copy);
+    mu_run_test(test_level_text_roundtrip);
+    mu_run_test(test_solve_level);
+    mu_run_test(test_disk_solve);
+    mu_run_test(test_solver_symmetry);
+    mu_run_test(test_count_solutions);
+    mu_run_test(test_doom_lost);
+    mu_run_test(test_tablebase);
+    mu_run_test(test_env_step);
+    mu_run_test(test_cooldown_eaten);
+    mu_run_test(test_ai_think);
+    mu_run_test(test_route_plan);
+    mu_run_test(test_herd);
+    mu_run_test(test_multiple_dragons);
+    mu_run_test(test_preview);
+    mu_run_test(test_preview_update);
+    mu_run_test(test_rules);
+    mu_run_test(test_tween_rest);
+    mu_run_test(test_terrain_refresh);
+    mu_run_test(test_atlas_pack);
+    mu_run_test(test_atlas_decode);
+    mu_run_test(test_assets_check);
+    mu_run_test(test_render_sort);
 
     if (tests_failed > 0) {
         printf("Passed: %d Failed: %d\n", tests_run - tests_failed, tests_failed);
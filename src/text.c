@@ -3,6 +3,134 @@
 #include "entity.h"
 #include "constants.h"
 #include "draw.h"
+#include "icon.h"
+#include "batch.h"
+#include "render.h"
+#include "atlas.h"
+#include "text.h"
+
+void text_invalidate(State* state) {
+    for (uint8_t r = 0; r < TEXT_CACHE_SIZE; r += 1) {
+        TextCache* cache = &state->text_cache[r];
+        if (cache->texture != NULL) {
+            SDL_DestroyTexture(cache->texture);
+            cache->texture = NULL;
+        }
+    }
+}
+
+/*
+ Draws the caption and its shadow into a new texture, leaving the render target and clipping the
+ way they were.
+ Returns: The texture, or NULL if it couldn't be made.
+ */
+static SDL_Texture* text_compose(State* state, IconID icon_id, int32_t w, int32_t h) {
+    SDL_Renderer* renderer = state->renderer;
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_TARGET, w + TEXT_SHADOW, h + TEXT_SHADOW);
+    if (texture == NULL) {
+        WARN("SDL_CreateTexture (text)");
+        return NULL;
+    }
+
+    /* Blending onto the cleared texture premultiplies its colors so they mustn't be again. */
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if (SDL_SetTextureBlendMode(texture, premultiplied) != 0) {
+        WARN("SDL_SetTextureBlendMode");
+        SDL_DestroyTexture(texture);
+        return NULL;
+    }
+
+    batch_flush(state);
+    bool queueing = render_pause(state);
+    SDL_Texture* target = SDL_GetRenderTarget(renderer);
+    SDL_Rect clip;
+    SDL_RenderGetClipRect(renderer, &clip);
+    bool clipped = SDL_RenderIsClipEnabled(renderer);
+
+    int status = SDL_SetRenderTarget(renderer, texture);
+    if (status == 0) {
+        if (SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0) != 0) {
+            WARN("SDL_SetRenderDrawColor");
+        }
+        if (SDL_RenderClear(renderer) != 0) {
+            WARN("SDL_RenderClear");
+        }
+        SDL_Rect dest_rect = {0, 0, w, h};
+        draw_text_shadow(state, icon_id, dest_rect);
+        batch_flush(state);
+    } else {
+        WARN("SDL_SetRenderTarget (text)");
+    }
+
+    if (SDL_SetRenderTarget(renderer, target) != 0) {
+        ERROR("SDL_SetRenderTarget");
+    }
+    if (SDL_RenderSetClipRect(renderer, clipped ? &clip : NULL) != 0) {
+        WARN("SDL_RenderSetClipRect");
+    }
+    render_resume(state, queueing);
+
+    if (status != 0) {
+        SDL_DestroyTexture(texture);
+        return NULL;
+    }
+    return texture;
+}
+
+static SDL_Texture* text_cached(State* state, IconID icon_id, int32_t w, int32_t h) {
+    TextCache* free_slot = NULL;
+    for (uint8_t r = 0; r < TEXT_CACHE_SIZE; r += 1) {
+        TextCache* cache = &state->text_cache[r];
+        if (cache->texture == NULL) {
+            if (free_slot == NULL) {
+                free_slot = cache;
+            }
+        } else if (cache->icon_id == icon_id && cache->w == w && cache->h == h) {
+            return cache->texture;
+        }
+    }
+
+    if (free_slot == NULL) {
+        /* Full of sizes that aren't used anymore, most likely. */
+        text_invalidate(state);
+        free_slot = &state->text_cache[0];
+    }
+    SDL_Texture* texture = text_compose(state, icon_id, w, h);
+    if (texture != NULL) {
+        free_slot->icon_id = icon_id;
+        free_slot->w = w;
+        free_slot->h = h;
+        free_slot->texture = texture;
+    }
+    return texture;
+}
+
+/*
+ Draws a caption with a shadow from the cache, which takes one copy instead of two draws with
+ changes of color in between.
+ */
+static void text_shadow_draw(State* state, IconID icon_id, SDL_Rect dest_rect) {
+    SDL_Texture* texture = text_cached(state, icon_id, dest_rect.w, dest_rect.h);
+    if (texture == NULL) {
+        draw_text_shadow(state, icon_id, dest_rect);
+        return;
+    }
+
+    dest_rect.w += TEXT_SHADOW;
+    dest_rect.h += TEXT_SHADOW;
+    if (state->render.queueing) {
+        render_copy(state, TEXTURE_UNKNOWN, texture, &dest_rect);
+        return;
+    }
+    batch_flush(state);
+    if (SDL_RenderCopy(state->renderer, texture, NULL, &dest_rect) != 0) {
+        WARN("SDL_RenderCopy");
+    }
+    render_count_draw(state, texture);
+}
 
 #define INSTRUCTIONS_WIDTH 351
 #define INSTRUCTIONS_HEIGHT 169
@@ -14,7 +142,7 @@ static void instructions_draw(State* state) {
         .w = INSTRUCTIONS_WIDTH / 2,
         .h = INSTRUCTIONS_HEIGHT / 2,
     };
-    draw_text_shadow(state, ICON_INSTRUCTIONS, dest_rect);
+    text_shadow_draw(state, ICON_INSTRUCTIONS, dest_rect);
 }
 
 #define FAILURE_WIDTH 186
@@ -23,7 +151,33 @@ static void instructions_draw(State* state) {
 #define SUCCESS_WIDTH 232
 #define SUCCESS_HEIGHT 48
 
+void text_icons_init(State* state) {
+    icon_texture_init(state, ICON_INSTRUCTIONS, TEXTURE_INSTRUCTIONS);
+    icon_texture_init(state, ICON_SUCCESS, TEXTURE_SUCCESS);
+    icon_texture_init(state, ICON_FAILURE, TEXTURE_FAILURE);
+}
+
+void text_poll(State* state) {
+    AtlasDecode* captions = &state->captions;
+    if (!atlas_decode_ready(captions)) {
+        return;
+    }
+
+    /* The workers are done so this only uploads. */
+    if (atlas_upload(state, captions) == 0) {
+        text_icons_init(state);
+        redraw(state);
+    } else {
+        WARN("atlas_upload (captions)");
+    }
+    atlas_decode_free(captions);
+    draw_loading_done();
+}
+
 void text_draw(State* state) {
+    if (state->textures[TEXTURE_INSTRUCTIONS] == NULL) {
+        return; /* Not loaded yet. */
+    }
     instructions_draw(state);
 
     if (state->game_over) {
@@ -34,7 +188,7 @@ void text_draw(State* state) {
                 .w = SUCCESS_WIDTH / 2,
                 .h = SUCCESS_HEIGHT / 2,
             };
-            draw_text_shadow(state, ICON_SUCCESS, dest_rect);
+            text_shadow_draw(state, ICON_SUCCESS, dest_rect);
         } else {
             SDL_Rect dest_rect = {
                 .x = VIEW_WIDTH / 2 - FAILURE_WIDTH / 4,
@@ -42,7 +196,7 @@ void text_draw(State* state) {
                 .w = FAILURE_WIDTH / 2,
                 .h = FAILURE_HEIGHT / 2,
             };
-            draw_text_shadow(state, ICON_FAILURE, dest_rect);
+            text_shadow_draw(state, ICON_FAILURE, dest_rect);
         }
     }
 }
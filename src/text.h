@@ -1,2 +1,18 @@
 
 void text_draw(State* state);
+
+/*
+ Throws away the cached captions, for when the textures they were drawn into lose their contents.
+ */
+void text_invalidate(State* state);
+
+/*
+ Uploads the captions once they're decoded, which starts in the background at startup so that
+ the first frame doesn't wait for them. Until then they're left out.
+ */
+void text_poll(State* state);
+
+/*
+ Points the caption icons at their textures, once those are uploaded.
+ */
+void text_icons_init(State* state);
@@ -3,7 +3,26 @@
 #include "entity.h"
 #include "constants.h"
 
-void tween_update(State* state) {
+/* Close enough to snap into place, in tiles. Well under a pixel. */
+#define TWEEN_REST 0.01f
+
+/*
+ Ease out by the fraction of the distance that's left after each second. A quarter of the way per
+ frame at 60fps, which is how it looked before it went by time.
+ */
+#define TWEEN_REMAINING_PER_SECOND 3.2e-8f
+
+static float_t tween_step(float_t from, float_t to, float_t remaining) {
+    float_t result = to + (from - to) * remaining;
+    if (fabsf(to - result) < TWEEN_REST) {
+        return to;
+    }
+    return result;
+}
+
+bool tween_update(State* state, float_t seconds) {
+    float_t remaining = powf(TWEEN_REMAINING_PER_SECOND, seconds);
+    bool moving = false;
     CompGroup* groups[] = {
         &state->components.compgroups[COMPTYPE_AVATAR],
         &state->components.compgroups[COMPTYPE_POSITION],
@@ -14,10 +33,11 @@ void tween_update(State* state) {
         CAvatar* avatar = (CAvatar*)comps[0];
         CPosition* position = (CPosition*)comps[1];
 
-        float_t factor = 4.0f;
-
-        /* TODO: This won't work properly in an unstable framerate. */
-        avatar->x += (((float_t)position->x) - avatar->x) / factor;
-        avatar->y += (((float_t)position->y) - avatar->y) / factor;
+        avatar->x = tween_step(avatar->x, (float_t)position->x, remaining);
+        avatar->y = tween_step(avatar->y, (float_t)position->y, remaining);
+        if (avatar->x != (float_t)position->x || avatar->y != (float_t)position->y) {
+            moving = true;
+        }
     }
+    return moving;
 }
@@ -1,2 +1,7 @@
 
-void tween_update(State* state);
+/*
+ Moves each avatar closer to its position by as much as it eases in the given time, so animations
+ take as long at any framerate.
+ Returns: true if any of them still has further to go.
+ */
+bool tween_update(State* state, float_t seconds);
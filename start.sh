@@ -44,6 +44,14 @@ cd .. || exit 1
 # TODO: need --static flag when statically linking
 # c99 -Wall -o ../${BIN} *.c `pkg-config --cflags --libs --static sdl2 SDL2_image` ${DEFINE} \
 
+# BAKE ASSETS
+
+# Decodes the images once here so that launching doesn't have to. See src/assets.c
+if [[ $1 != 'test' ]]; then
+    ${BIN} bake ./bin/assets.bin || exit 1
+fi
+
 # EXECUTE
 
-${BIN}
+# Arguments after the build mode are passed to the app, e.g. ./start.sh release generate 20
+${BIN} "${@:2}"